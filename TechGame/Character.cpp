@@ -12,6 +12,7 @@
 
 #include "NewtonPhysicsWorld.h"
 #include "NewtonPhysicsEvents.h"
+#include "PieceAimQuery.h"
 #include "NewtonRigidBody.h"
 
 #include "Character.h"
@@ -231,6 +232,8 @@ void Character::ResolveNodes()
 
 	auto* camera = headNode_->GetOrCreateComponent<Camera>();
 	camera->SetFarClip(500.0f);
+	//pick-only drawables (piece models hidden behind a merged group visual) carry just the pickable bit.
+	camera->SetViewMask(DEFAULT_VIEWMASK & ~PIECE_VIEWMASK_PICKABLE);
 
 	SoundListener* soundListener = headNode_->GetOrCreateComponent<SoundListener>();
 
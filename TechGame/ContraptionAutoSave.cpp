@@ -0,0 +1,157 @@
+#include "ContraptionAutoSave.h"
+#include "PieceManager.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <stdio.h>
+#endif
+
+
+
+//move from over to, replacing an existing file in one step - readers see either the old or the new file, never neither.
+static bool MoveFileOver(const ea::string& from, const ea::string& to)
+{
+	ea::string nativeFrom = GetNativePath(from);
+	ea::string nativeTo = GetNativePath(to);
+
+#ifdef _WIN32
+	return MoveFileExA(nativeFrom.c_str(), nativeTo.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(nativeFrom.c_str(), nativeTo.c_str()) == 0;
+#endif
+}
+
+
+ContraptionAutoSave::ContraptionAutoSave(Context* context) : Component(context)
+{
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(ContraptionAutoSave, HandleUpdate));
+}
+
+ContraptionAutoSave::~ContraptionAutoSave()
+{
+	CancelSave();
+}
+
+void ContraptionAutoSave::RegisterObject(Context* context)
+{
+	context->RegisterFactory<ContraptionAutoSave>();
+}
+
+bool ContraptionAutoSave::SaveNow()
+{
+	if (IsSaving() || !GetScene())
+		return false;
+
+	PieceManager* pieceManager = GetScene()->GetComponent<PieceManager>();
+	if (!pieceManager)
+		return false;
+
+	SharedPtr<SaveJob> job(new SaveJob());
+
+	HiresTimer captureTimer;
+	pieceManager->CaptureContraption(job->data_);
+	lastCaptureUSec_ = captureTimer.GetUSec(false);
+
+	//the file is opened here - File objects are created on the main thread, the worker only writes.
+	job->tempFileName_ = fileName_ + ".tmp";
+	job->file_ = new File(context_, job->tempFileName_, FILE_WRITE);
+	if (!job->file_->IsOpen())
+	{
+		URHO3D_LOGWARNING("ContraptionAutoSave: cannot write " + job->tempFileName_);
+		return false;
+	}
+
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	workItem_ = queue->GetFreeItem();
+	workItem_->workFunction_ = SaveWork;
+	workItem_->aux_ = job.Get();
+	workItem_->sendEvent_ = false;
+	job_ = job;
+
+	queue->AddWorkItem(workItem_);
+	return true;
+}
+
+void ContraptionAutoSave::SaveWork(const WorkItem* item, unsigned threadIndex)
+{
+	SaveJob* job = reinterpret_cast<SaveJob*>(item->aux_);
+
+	VectorBuffer buffer;
+	if (job->data_.WriteCompressed(buffer))
+		job->success_ = job->file_->Write(buffer.GetData(), buffer.GetSize()) == buffer.GetSize();
+
+	job->file_->Close();
+}
+
+void ContraptionAutoSave::FinishSave()
+{
+	SharedPtr<SaveJob> job = job_;
+	job_ = nullptr;
+	workItem_ = nullptr;
+
+	FileSystem* fileSystem = GetSubsystem<FileSystem>();
+	if (!job->success_)
+	{
+		URHO3D_LOGWARNING("ContraptionAutoSave: failed writing " + job->tempFileName_);
+		fileSystem->Delete(job->tempFileName_);
+		return;
+	}
+
+	//swap in the finished file so a crash mid-write never leaves a broken autosave.
+	if (!MoveFileOver(job->tempFileName_, fileName_))
+	{
+		URHO3D_LOGWARNING("ContraptionAutoSave: cannot replace " + fileName_ + " with " + job->tempFileName_);
+		fileSystem->Delete(job->tempFileName_);
+		return;
+	}
+
+	URHO3D_LOGINFO("ContraptionAutoSave: saved " + ea::to_string(job->data_.pieces_.size()) + " pieces to " + fileName_
+		+ " (capture " + ea::to_string(lastCaptureUSec_) + " us)");
+}
+
+void ContraptionAutoSave::CancelSave()
+{
+	if (!workItem_)
+		return;
+
+	//the job must not be freed while a worker is still writing it.
+	if (!workItem_->completed_ && !GetSubsystem<WorkQueue>()->RemoveWorkItem(workItem_))
+	{
+		while (!workItem_->completed_)
+			Time::Sleep(0);
+	}
+
+	//a half written temp file is never swapped in - remove it.
+	if (job_->file_)
+		job_->file_->Close();
+	GetSubsystem<FileSystem>()->Delete(job_->tempFileName_);
+
+	workItem_ = nullptr;
+	job_ = nullptr;
+}
+
+void ContraptionAutoSave::HandleUpdate(StringHash event, VariantMap& eventData)
+{
+	using namespace Update;
+
+	if (workItem_)
+	{
+		if (!workItem_->completed_)
+			return;
+
+		FinishSave();
+	}
+
+	if (!IsEnabledEffective())
+		return;
+
+	timeSinceSave_ += eventData[P_TIMESTEP].GetFloat();
+	if (timeSinceSave_ >= interval_)
+	{
+		timeSinceSave_ = 0.0f;
+		SaveNow();
+	}
+}
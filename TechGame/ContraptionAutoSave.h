@@ -0,0 +1,64 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+#include "PieceContraptionFile.h"
+
+
+#define CONTRAPTION_AUTOSAVE_FILENAME "autosave.mcz"
+
+
+//periodic autosave of all pieces.  attach to the scene node.
+//the main thread only captures a plain-data snapshot (PieceManager::CaptureContraption); encoding, lz4 compression and the
+//file write run on a worker thread.  the file is written to a temp name and swapped in once complete.
+class ContraptionAutoSave : public Component
+{
+	URHO3D_OBJECT(ContraptionAutoSave, Component);
+
+public:
+
+	ContraptionAutoSave(Context* context);
+	virtual ~ContraptionAutoSave();
+
+	static void RegisterObject(Context* context);
+
+	///seconds between saves.
+	void SetInterval(float seconds) { interval_ = seconds; }
+	float GetInterval() const { return interval_; }
+
+	void SetFileName(const ea::string& fileName) { fileName_ = fileName; }
+	const ea::string& GetFileName() const { return fileName_; }
+
+	///start a save now unless one is still being written.
+	bool SaveNow();
+
+	bool IsSaving() const { return workItem_ != nullptr; }
+
+	///main thread time of the last snapshot capture in microseconds.
+	long long GetLastCaptureUSec() const { return lastCaptureUSec_; }
+
+protected:
+
+	//everything the worker thread touches.
+	struct SaveJob : public RefCounted {
+		ContraptionFileData data_;
+		ea::string tempFileName_;
+		SharedPtr<File> file_;
+		bool success_ = false;
+	};
+
+	static void SaveWork(const WorkItem* item, unsigned threadIndex);
+
+	void FinishSave();
+
+	void CancelSave();
+
+	void HandleUpdate(StringHash event, VariantMap& eventData);
+
+	float interval_ = 60.0f;
+	float timeSinceSave_ = 0.0f;
+	ea::string fileName_ = CONTRAPTION_AUTOSAVE_FILENAME;
+
+	SharedPtr<SaveJob> job_;
+	SharedPtr<WorkItem> workItem_;
+
+	long long lastCaptureUSec_ = 0;
+};
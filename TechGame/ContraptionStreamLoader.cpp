@@ -0,0 +1,206 @@
+#include "ContraptionStreamLoader.h"
+#include "PieceManager.h"
+#include "Piece.h"
+#include "MappedFile.h"
+
+
+
+ContraptionStreamLoader::ContraptionStreamLoader(Context* context) : Component(context)
+{
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(ContraptionStreamLoader, HandleUpdate));
+}
+
+void ContraptionStreamLoader::RegisterObject(Context* context)
+{
+	context->RegisterFactory<ContraptionStreamLoader>();
+}
+
+bool ContraptionStreamLoader::Start(const ea::string& fileName)
+{
+	Cancel();
+
+	MappedFile file;
+	if (!file.Open(fileName))
+	{
+		URHO3D_LOGWARNING("ContraptionStreamLoader: cannot open " + fileName);
+		return false;
+	}
+
+	//decoding is cheap next to instantiation - do it all now and release the mapping.
+	MemoryBuffer buffer(file.GetData(), file.GetSize());
+	data_ = ContraptionFileData();
+	if (!data_.Read(buffer))
+	{
+		URHO3D_LOGWARNING("ContraptionStreamLoader: corrupt contraption data in " + fileName);
+		return false;
+	}
+
+	fileName_ = fileName;
+	PlanContraptions();
+
+	contraptionIndex_ = 0;
+	stage_ = Stage_Pieces;
+	itemIndex_ = 0;
+	numItemsDone_ = 0;
+	numItemsTotal_ = data_.pieces_.size() + data_.attachments_.size();
+	loadTimer_.Reset();
+
+	builder_ = ea::make_unique<ContraptionBuilder>(GetScene()->GetComponent<PieceManager>(), &data_);
+	return true;
+}
+
+void ContraptionStreamLoader::Cancel()
+{
+	if (builder_)
+		builder_->Abort();
+
+	EndLoad();
+}
+
+float ContraptionStreamLoader::GetProgress() const
+{
+	if (!IsLoading() || !numItemsTotal_)
+		return 1.0f;
+
+	return float(numItemsDone_) / float(numItemsTotal_);
+}
+
+void ContraptionStreamLoader::PlanContraptions()
+{
+	//union-find over pieces.
+	ea::vector<unsigned> parents(data_.pieces_.size());
+	for (unsigned i = 0; i < parents.size(); i++)
+		parents[i] = i;
+
+	auto findRoot = [&parents](unsigned i) {
+		while (parents[i] != i)
+		{
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	};
+
+	for (const ContraptionFileData::Attachment& attachment : data_.attachments_)
+		parents[findRoot(attachment.piece_[0])] = findRoot(attachment.piece_[1]);
+
+	ea::vector<unsigned> assemblyRoots(data_.assemblies_.size(), M_MAX_UNSIGNED);
+	for (unsigned i = 0; i < data_.pieces_.size(); i++)
+	{
+		unsigned assembly = data_.pieces_[i].assembly_;
+		if (!assembly)
+			continue;
+
+		if (assemblyRoots[assembly - 1] == M_MAX_UNSIGNED)
+			assemblyRoots[assembly - 1] = i;
+		else
+			parents[findRoot(i)] = findRoot(assemblyRoots[assembly - 1]);
+	}
+
+
+	contraptions_.clear();
+	ea::hash_map<unsigned, unsigned> contraptionIndexes;
+	auto getContraption = [&](unsigned piece) -> Contraption& {
+		unsigned root = findRoot(piece);
+		auto it = contraptionIndexes.find(root);
+		if (it != contraptionIndexes.end())
+			return contraptions_[it->second];
+
+		contraptionIndexes.insert_or_assign(root, contraptions_.size());
+		contraptions_.emplace_back();
+		return contraptions_.back();
+	};
+
+	for (unsigned i = 0; i < data_.pieces_.size(); i++)
+		getContraption(i).pieces_.push_back(i);
+
+	for (unsigned i = 0; i < data_.attachments_.size(); i++)
+		getContraption(data_.attachments_[i].piece_[0]).attachments_.push_back(i);
+}
+
+bool ContraptionStreamLoader::Step()
+{
+	Contraption& contraption = contraptions_[contraptionIndex_];
+
+	switch (stage_)
+	{
+	case Stage_Pieces:
+		if (itemIndex_ < contraption.pieces_.size())
+		{
+			if (!builder_->SpawnPiece(contraption.pieces_[itemIndex_], true))
+				return false;
+
+			itemIndex_++;
+			numItemsDone_++;
+			return true;
+		}
+		stage_ = Stage_Attachments;
+		itemIndex_ = 0;
+		return true;
+
+	case Stage_Attachments:
+		if (itemIndex_ < contraption.attachments_.size())
+		{
+			if (!builder_->Attach(contraption.attachments_[itemIndex_]))
+				URHO3D_LOGWARNING("ContraptionStreamLoader: could not restore attachment " + ea::to_string(contraption.attachments_[itemIndex_]));
+
+			itemIndex_++;
+			numItemsDone_++;
+			return true;
+		}
+		stage_ = Stage_Finish;
+		return true;
+
+	case Stage_Finish:
+		//contraption is complete - unfreeze and group it.  only its own branches are rebuilt, the rest of the scene is untouched.
+		if (builder_->FinishPieces(contraption.pieces_))
+		{
+			ea::vector<Node*> nodes;
+			for (unsigned index : contraption.pieces_)
+			{
+				if (Piece* piece = builder_->GetPiece(index))
+					nodes.push_back(piece->GetNode());
+			}
+			GetScene()->GetComponent<PieceManager>()->RebuildSolidifiesBranches(nodes);
+		}
+
+		contraptionIndex_++;
+		stage_ = Stage_Pieces;
+		itemIndex_ = 0;
+		return true;
+	}
+
+	return true;
+}
+
+void ContraptionStreamLoader::EndLoad()
+{
+	builder_.reset();
+	data_ = ContraptionFileData();
+	contraptions_.clear();
+	fileName_.clear();
+}
+
+void ContraptionStreamLoader::HandleUpdate(StringHash event, VariantMap& eventData)
+{
+	if (!IsLoading())
+		return;
+
+	HiresTimer frameTimer;
+	while (contraptionIndex_ < contraptions_.size())
+	{
+		if (!Step())
+		{
+			URHO3D_LOGWARNING("ContraptionStreamLoader: failed loading " + fileName_);
+			Cancel();
+			return;
+		}
+
+		if (frameTimer.GetUSec(false) >= (long long)(frameBudgetMs_ * 1000.0f))
+			return;
+	}
+
+	URHO3D_LOGINFO("ContraptionStreamLoader: loaded " + ea::to_string(data_.pieces_.size()) + " pieces in " + ea::to_string(contraptions_.size())
+		+ " contraptions from " + fileName_ + " (" + ea::to_string(loadTimer_.GetUSec(false) / 1000) + " ms)");
+	EndLoad();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+#include "PieceContraptionFile.h"
+
+
+//time-sliced loader for binary contraption files.  attach to the scene node.
+//the file is decoded up front, then pieces are spawned, attached and grouped one contraption (set of connected pieces) at a time
+//under a per-frame time budget.  bodies stay frozen until everything they are connected to exists.
+class ContraptionStreamLoader : public Component
+{
+	URHO3D_OBJECT(ContraptionStreamLoader, Component);
+
+public:
+
+	ContraptionStreamLoader(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	///start streaming fileName into the scene.  cancels a load in progress.
+	bool Start(const ea::string& fileName);
+
+	///stop loading and remove everything the current load has spawned.
+	void Cancel();
+
+	bool IsLoading() const { return builder_ != nullptr; }
+
+	///0..1 over all pieces and attachments of the current load.
+	float GetProgress() const;
+
+	void SetFrameBudgetMs(float budget) { frameBudgetMs_ = budget; }
+	float GetFrameBudgetMs() const { return frameBudgetMs_; }
+
+protected:
+
+	struct Contraption {
+		ea::vector<unsigned> pieces_;
+		ea::vector<unsigned> attachments_;
+	};
+
+	enum Stage {
+		Stage_Pieces = 0,
+		Stage_Attachments,
+		Stage_Finish
+	};
+
+	//group pieces into contraptions by attachments and assemblies.
+	void PlanContraptions();
+
+	//do one unit of work.  returns false when the load failed.
+	bool Step();
+
+	void EndLoad();
+
+	void HandleUpdate(StringHash event, VariantMap& eventData);
+
+	float frameBudgetMs_ = 4.0f;
+
+	ea::string fileName_;
+	ContraptionFileData data_;
+	ea::unique_ptr<ContraptionBuilder> builder_;
+
+	ea::vector<Contraption> contraptions_;
+	unsigned contraptionIndex_ = 0;
+	Stage stage_ = Stage_Pieces;
+	unsigned itemIndex_ = 0;
+
+	unsigned numItemsDone_ = 0;
+	unsigned numItemsTotal_ = 0;
+	HiresTimer loadTimer_;
+};
@@ -0,0 +1,183 @@
+#include "HeadlessSimulation.h"
+#include "PieceManager.h"
+#include "PhysicsReplay.h"
+#include "PhysicsSolverGovernor.h"
+
+#include "NewtonPhysicsWorld.h"
+#include "NewtonPhysicsEvents.h"
+#include "NewtonRigidBody.h"
+#include "NewtonCollisionShapesDerived.h"
+
+#include "EASTL/sort.h"
+
+
+
+HeadlessSimulation::HeadlessSimulation(Context* context) : Object(context)
+{
+}
+
+void HeadlessSimulation::ParseArguments(const StringVector& arguments)
+{
+	for (unsigned i = 0; i + 1 < arguments.size(); i++)
+	{
+		const ea::string& argument = arguments[i];
+		const ea::string& value = arguments[i + 1];
+
+		if (argument == "-Contraption")
+			contraptionFileName_ = value;
+		else if (argument == "-Replay")
+			replayFileName_ = value;
+		else if (argument == "-Frames")
+			numFrames_ = ToUInt(value);
+		else if (argument == "-TimeStep")
+			timeStep_ = Max(ToFloat(value), M_EPSILON);
+		else if (argument == "-Budget")
+			budgetUSec_ = ToInt64(value);
+	}
+}
+
+bool HeadlessSimulation::CreateScene()
+{
+	//same seed and piece systems on physics steps - two runs with the same arguments step identically.
+	SetRandomSeed(1);
+
+	scene_ = new Scene(context_);
+	scene_->CreateComponent<Octree>();
+	scene_->CreateComponent<PieceManager>()->SetFixedStepUpdates(true);
+	NewtonPhysicsWorld* physicsWorld = scene_->CreateComponent<NewtonPhysicsWorld>();
+	physicsWorld->SetGravity(Vector3(0, -9.81, 0));
+
+	//same ground as TechGame::DefaultCreateScene.
+	Node* floorNode = scene_->CreateChild("Floor");
+	floorNode->SetPosition(Vector3(0.0f, -5, 0.0f));
+	floorNode->SetScale(Vector3(1000.0f, 10.0f, 1000.0f));
+	floorNode->CreateComponent<NewtonRigidBody>()->SetMassScale(0.0f);
+	floorNode->CreateComponent<NewtonCollisionShape_Box>();
+
+	if (budgetUSec_ > 0)
+		scene_->CreateComponent<PhysicsSolverGovernor>()->SetBudgetUSec(budgetUSec_);
+
+	if (replayFileName_.length())
+		return true;
+
+	PieceManager* pieceManager = scene_->GetComponent<PieceManager>();
+	if (!pieceManager->LoadContraptionFile(contraptionFileName_))
+	{
+		URHO3D_LOGERROR("HeadlessSimulation: could not load " + contraptionFileName_);
+		return false;
+	}
+	return true;
+}
+
+bool HeadlessSimulation::Run()
+{
+	//playback switches the physics world off (and replaces the scene) - there is no step for a governor to hold in budget.
+	if (replayFileName_.length() && budgetUSec_ > 0)
+	{
+		URHO3D_LOGERROR("HeadlessSimulation: -Budget cannot be combined with -Replay");
+		return false;
+	}
+
+	if (!CreateScene())
+		return false;
+
+	SharedPtr<PhysicsReplayPlayer> player;
+	if (replayFileName_.length())
+	{
+		player = new PhysicsReplayPlayer(context_);
+		if (!player->Open(replayFileName_) || !player->LoadScene(scene_))
+		{
+			URHO3D_LOGERROR("HeadlessSimulation: could not load replay " + replayFileName_);
+			return false;
+		}
+
+		//the replay drives the transforms.
+		if (NewtonPhysicsWorld* physicsWorld = scene_->GetComponent<NewtonPhysicsWorld>())
+			physicsWorld->SetEnabled(false);
+		numFrames_ = Min(numFrames_, player->GetNumFrames());
+	}
+
+	PieceManager* pieceManager = scene_->GetComponent<PieceManager>();
+	PrintLine("HeadlessSimulation: " + ea::to_string(pieceManager ? pieceManager->GetAllPieces().size() : 0) + " pieces, "
+		+ ea::to_string(numFrames_) + " frames");
+
+	SubscribeToEvent(E_NEWTON_PHYSICSPRESTEP, URHO3D_HANDLER(HeadlessSimulation, HandlePhysicsPreStep));
+	SubscribeToEvent(E_NEWTON_PHYSICSPOSTSTEP, URHO3D_HANDLER(HeadlessSimulation, HandlePhysicsPostStep));
+
+	Engine* engine = GetSubsystem<Engine>();
+	ea::vector<long long> frameTimes;
+	frameTimes.reserve(numFrames_);
+	physicsStepTimes_.reserve(numFrames_);
+
+	HiresTimer totalTimer;
+	for (unsigned i = 0; i < numFrames_; i++)
+	{
+		HiresTimer frameTimer;
+
+		if (player && !player->StepFrame())
+			break;
+
+		//the regular frame events - scene, physics and every piece system update exactly as in the game.
+		engine->SetNextTimeStep(timeStep_);
+		engine->Update();
+
+		frameTimes.push_back(frameTimer.GetUSec(false));
+	}
+	long long totalUSec = totalTimer.GetUSec(false);
+
+	UnsubscribeFromAllEvents();
+
+	PrintLine("HeadlessSimulation: " + ea::to_string(frameTimes.size()) + " frames in " + ea::to_string(totalUSec / 1000) + " ms ("
+		+ ea::to_string(totalUSec ? frameTimes.size() * 1000000.0 / totalUSec : 0.0) + " frames/s, "
+		+ ea::to_string(frameTimes.size() * timeStep_) + " s simulated)");
+	PrintStatistics("frame", frameTimes);
+	PrintStatistics("physics step", physicsStepTimes_);
+
+	if (pieceManager)
+	{
+		PrintLine(pieceManager->GetPhysicsStepHistogram().ToString("physics step histogram"), false);
+		PrintLine(pieceManager->GetPieceTickHistogram().ToString("piece tick histogram"), false);
+	}
+
+	if (PhysicsSolverGovernor* governor = scene_->GetComponent<PhysicsSolverGovernor>())
+	{
+		PrintLine("  solver governor decisions:");
+		for (const PhysicsSolverDecision& decision : governor->GetDecisions())
+			PrintLine("    step " + ea::to_string(decision.step_) + ": " + decision.reason_ + " (avg " + ea::to_string(decision.averageUSec_) + " us) -> "
+				+ ea::to_string(decision.iterations_) + " iterations, " + ea::to_string(decision.subSteps_) + " substeps");
+	}
+
+	scene_ = nullptr;
+	return true;
+}
+
+void HeadlessSimulation::PrintStatistics(const ea::string& label, ea::vector<long long>& samples) const
+{
+	if (samples.empty())
+		return;
+
+	ea::sort(samples.begin(), samples.end());
+
+	long long total = 0;
+	for (long long sample : samples)
+		total += sample;
+
+	auto percentile = [&samples](float p) { return samples[Min(unsigned(p * samples.size()), unsigned(samples.size() - 1))]; };
+
+	PrintLine("  " + label + " us: min " + ea::to_string(samples.front())
+		+ "  avg " + ea::to_string(total / (long long)samples.size())
+		+ "  p50 " + ea::to_string(percentile(0.5f))
+		+ "  p95 " + ea::to_string(percentile(0.95f))
+		+ "  p99 " + ea::to_string(percentile(0.99f))
+		+ "  max " + ea::to_string(samples.back()));
+}
+
+void HeadlessSimulation::HandlePhysicsPreStep(StringHash event, VariantMap& eventData)
+{
+	physicsTimer_.Reset();
+}
+
+void HeadlessSimulation::HandlePhysicsPostStep(StringHash event, VariantMap& eventData)
+{
+	physicsStepTimes_.push_back(physicsTimer_.GetUSec(false));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+//benchmark run without graphics, audio, camera or ui (-Headless, or the TechGameHeadless target).
+//loads a saved contraption (or a physics replay), steps the scene for a number of frames as fast as possible and prints timing statistics.
+//piece systems run in fixed step mode (PieceManager::SetFixedStepUpdates) with a fixed random seed so runs are reproducible.
+//
+//	-Contraption <file>	binary contraption to simulate (default contraptionSave.bin)
+//	-Replay <file>		play a PhysicsReplayRecorder dump instead of simulating
+//	-Frames <n>			frames to step (default 1000, a replay stops at its end)
+//	-TimeStep <s>		fixed frame time step (default 1/60)
+//	-Budget <us>		run PhysicsSolverGovernor with this physics step budget and print its decisions (not with -Replay)
+class HeadlessSimulation : public Object
+{
+	URHO3D_OBJECT(HeadlessSimulation, Object);
+
+public:
+
+	HeadlessSimulation(Context* context);
+
+	void ParseArguments(const StringVector& arguments);
+
+	///returns false if the scene could not be set up.
+	bool Run();
+
+protected:
+
+	bool CreateScene();
+
+	void PrintStatistics(const ea::string& label, ea::vector<long long>& samples) const;
+
+	void HandlePhysicsPreStep(StringHash event, VariantMap& eventData);
+	void HandlePhysicsPostStep(StringHash event, VariantMap& eventData);
+
+	ea::string contraptionFileName_ = "contraptionSave.bin";
+	ea::string replayFileName_;
+	unsigned numFrames_ = 1000;
+	float timeStep_ = 1.0f / 60.0f;
+	long long budgetUSec_ = 0;
+
+	SharedPtr<Scene> scene_;
+
+	HiresTimer physicsTimer_;
+	ea::vector<long long> physicsStepTimes_;
+};
@@ -0,0 +1,182 @@
+#include "ImpactAudio.h"
+#include "PhysicsContactStream.h"
+
+#include "Urho3D/Audio/Audio.h"
+#include "Urho3D/Audio/SoundListener.h"
+#include "Urho3D/Audio/SoundSource3D.h"
+
+
+
+ImpactAudio::ImpactAudio(Context* context) : Component(context)
+{
+}
+
+void ImpactAudio::RegisterObject(Context* context)
+{
+	context->RegisterFactory<ImpactAudio>();
+}
+
+void ImpactAudio::SetNumVoices(unsigned count)
+{
+	RemoveVoices();
+	if (GetScene())
+		CreateVoices(count);
+}
+
+unsigned ImpactAudio::GetNumPlaying() const
+{
+	unsigned count = 0;
+	for (const Voice& voice : voices_)
+	{
+		if (voice.source_ && voice.source_->IsPlaying())
+			count++;
+	}
+	return count;
+}
+
+void ImpactAudio::CreateVoices(unsigned count)
+{
+	for (unsigned i = 0; i < count; i++)
+	{
+		Node* voiceNode = node_->CreateChild("ImpactVoice");
+		voiceNode->SetTemporary(true);
+
+		SoundSource3D* source = voiceNode->CreateComponent<SoundSource3D>();
+		source->SetNearDistance(nearDistance_);
+		source->SetFarDistance(farDistance_);
+
+		Voice voice;
+		voice.source_ = source;
+		voices_.push_back(voice);
+	}
+}
+
+void ImpactAudio::RemoveVoices()
+{
+	for (Voice& voice : voices_)
+	{
+		if (voice.source_)
+			voice.source_->GetNode()->Remove();
+	}
+	voices_.clear();
+}
+
+void ImpactAudio::OnSceneSet(Scene* scene)
+{
+	if (!scene)
+	{
+		UnsubscribeFromAllEvents();
+		RemoveVoices();
+		return;
+	}
+
+	if (sounds_.empty())
+	{
+		//the set the old per impact sound code picked from.
+		ResourceCache* cache = GetSubsystem<ResourceCache>();
+		AddSound(cache->GetResource<Sound>("Sounds/Metal Sounds/metal_sound_81.wav"));
+		AddSound(cache->GetResource<Sound>("Sounds/Metal Sounds/metal_sound_82.wav"));
+		AddSound(cache->GetResource<Sound>("Sounds/Metal Sounds/metal_sound_83.wav"));
+	}
+
+	if (voices_.empty())
+		CreateVoices(8);
+
+	PhysicsContactStream* stream = scene->GetOrCreateComponent<PhysicsContactStream>();
+	SubscribeToEvent(stream, E_PHYSICSCONTACTS, URHO3D_HANDLER(ImpactAudio, HandlePhysicsContacts));
+}
+
+void ImpactAudio::HandlePhysicsContacts(StringHash event, VariantMap& eventData)
+{
+	using namespace PhysicsContacts;
+
+	if (!IsEnabledEffective() || voices_.empty() || sounds_.empty())
+		return;
+
+	PhysicsContactStream* stream = static_cast<PhysicsContactStream*>(eventData[P_STREAM].GetPtr());
+	if (stream->GetImpacts().empty())
+		return;
+	float time = GetScene()->GetElapsedTime();
+
+	Vector3 listenerPosition;
+	SoundListener* listener = GetSubsystem<Audio>() ? GetSubsystem<Audio>()->GetListener() : nullptr;
+	if (listener)
+		listenerPosition = listener->GetNode()->GetWorldPosition();
+
+	//forget bodies that have been quiet for a while so the map does not grow with every body that ever hit something.
+	if (time - pruneTime_ > 5.0f)
+	{
+		for (auto it = lastPlayTimes_.begin(); it != lastPlayTimes_.end();)
+		{
+			if (time - it->second > bodyInterval_)
+				it = lastPlayTimes_.erase(it);
+			else
+				++it;
+		}
+		pruneTime_ = time;
+	}
+
+	//impacts come strongest first.
+	for (const PhysicsImpact& impact : stream->GetImpacts())
+	{
+		//static bodies are not rate limited - one thing hitting the ground must not silence the ground for everything else.
+		NewtonRigidBody* bodyA = impact.categoryA_ != PhysicsContactCategory_Static ? impact.bodyA_.Get() : nullptr;
+		NewtonRigidBody* bodyB = impact.categoryB_ != PhysicsContactCategory_Static ? impact.bodyB_.Get() : nullptr;
+
+		//the pair is busy if either body played recently - a beam rattling on the ground plays once.
+		bool limited = false;
+		for (NewtonRigidBody* body : { bodyA, bodyB })
+		{
+			auto it = lastPlayTimes_.find(body);
+			if (body && it != lastPlayTimes_.end() && time - it->second < bodyInterval_)
+				limited = true;
+		}
+		if (limited)
+		{
+			numDropped_++;
+			continue;
+		}
+
+		float distance = listener ? (impact.position_ - listenerPosition).Length() : 0.0f;
+		if (distance > farDistance_)
+		{
+			numDropped_++;
+			continue;
+		}
+		float priority = impact.impulse_ / (1.0f + distance);
+
+		//a free voice, otherwise the weakest one if this impact outranks it.
+		Voice* target = nullptr;
+		for (Voice& voice : voices_)
+		{
+			if (!voice.source_)
+				continue;
+
+			if (!voice.source_->IsPlaying())
+			{
+				target = &voice;
+				break;
+			}
+			if (voice.priority_ < priority && (!target || voice.priority_ < target->priority_))
+				target = &voice;
+		}
+		if (!target)
+		{
+			numDropped_++;
+			continue;
+		}
+
+		Sound* sound = sounds_[Random((int)sounds_.size())];
+		if (!sound)
+			continue;
+
+		target->priority_ = priority;
+		target->source_->GetNode()->SetWorldPosition(impact.position_);
+		target->source_->Play(sound, sound->GetFrequency() * Random(0.9f, 1.1f), Clamp(impact.impulse_ / fullGainImpulse_, 0.05f, 1.0f));
+
+		if (bodyA)
+			lastPlayTimes_[bodyA] = time;
+		if (bodyB)
+			lastPlayTimes_[bodyB] = time;
+	}
+}
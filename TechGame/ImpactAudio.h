@@ -0,0 +1,65 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+class NewtonRigidBody;
+class PhysicsContactStream;
+
+//impact sounds driven by the scene's PhysicsContactStream.  attach to the scene node.
+//a fixed pool of voices (one temporary node with a SoundSource3D each) is created once and moved to each impact - nothing is created
+//or removed in the collision path.  impacts are ranked by impulse over distance to the listener; with every voice busy the weakest
+//playing voice is stolen if the new impact outranks it.  each body plays at most once per body interval.
+class ImpactAudio : public Component
+{
+	URHO3D_OBJECT(ImpactAudio, Component);
+
+public:
+
+	ImpactAudio(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	///size of the voice pool.  rebuilds it.
+	void SetNumVoices(unsigned count);
+	unsigned GetNumVoices() const { return voices_.size(); }
+
+	///seconds a body stays silent after it played.
+	void SetBodyInterval(float seconds) { bodyInterval_ = seconds; }
+
+	///impulse that plays at full gain.
+	void SetFullGainImpulse(float impulse) { fullGainImpulse_ = Max(impulse, M_EPSILON); }
+
+	void AddSound(Sound* sound) { sounds_.push_back(SharedPtr<Sound>(sound)); }
+
+	unsigned GetNumPlaying() const;
+
+	///impacts dropped for rate limit or lack of a voice since the start.
+	unsigned GetNumDropped() const { return numDropped_; }
+
+protected:
+
+	struct Voice {
+		WeakPtr<SoundSource3D> source_;
+		float priority_ = 0.0f;
+	};
+
+	void CreateVoices(unsigned count);
+	void RemoveVoices();
+
+	virtual void OnSceneSet(Scene* scene) override;
+
+	void HandlePhysicsContacts(StringHash event, VariantMap& eventData);
+
+	ea::vector<Voice> voices_;
+	ea::vector<SharedPtr<Sound>> sounds_;
+
+	float bodyInterval_ = 0.25f;
+	float fullGainImpulse_ = 20.0f;
+	float nearDistance_ = 1.0f;
+	float farDistance_ = 50.0f;
+
+	ea::hash_map<NewtonRigidBody*, float> lastPlayTimes_;//lookup only - never dereferenced.
+	float pruneTime_ = 0.0f;
+
+	unsigned numDropped_ = 0;
+};
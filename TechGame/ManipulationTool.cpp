@@ -7,6 +7,8 @@
 #include "MathExtras.h"
 #include "PieceGear.h"
 #include "VisualDebugger.h"
+#include "PieceAimQuery.h"
+#include "PieceUndoJournal.h"
 
 #include "NewtonPhysicsEvents.h"
 
@@ -151,6 +153,8 @@ bool ManipulationTool::Gather(bool grabOne)
 	//resolve piece and store both at currently gathered.
 	Piece* piece = piecePoint->GetPiece();
 
+	//a contraption solidified by the LOD goes back to its own groups before anything is moved.
+	pieceManager_->WakeContraption(piece);
 
 	gatheredPiece_ = piece;
 	gatherPiecePoint_ = piecePoint;
@@ -173,6 +177,9 @@ bool ManipulationTool::Gather(bool grabOne)
 		for(Piece* pc : allGatherPieces_)
 			pc->GetPoints(allGatherPiecePoints_);
 
+		//the move stays open until drop so an attach made on release joins it.
+		pieceManager_->GetUndoJournal()->BeginOperation("Move", allGatherPieces_);
+
 
 
 		PieceSolidificationGroup* existingGroup = gatheredPiece_->GetPieceGroup();
@@ -191,9 +198,9 @@ bool ManipulationTool::Gather(bool grabOne)
 
 
 
-		for (Piece* pc : piecesInGroup) {
-			pieceManager_->FormSolidGroup(pc);
-		}
+		//the rest of the old group regroups off the main thread.
+		if (piecesInGroup.size())
+			pieceManager_->RequestAutoFormAllGroups();
 		
 		
 	}
@@ -201,6 +208,8 @@ bool ManipulationTool::Gather(bool grabOne)
 	{
 		//form list of all connected pieces to the gathered piece and store in allGatherPieces_
 		formGatherContraption(false);
+
+		pieceManager_->GetUndoJournal()->BeginOperation("Move", allGatherPieces_);
 	}
 
 
@@ -318,6 +327,8 @@ void ManipulationTool::InstantDuplicatePiece()
 	ea::string pieceName = aimPiece->GetNode()->GetVar("PieceName").ToString();
 	ea::string assemblyName = aimPiece->GetNode()->GetVar("AssemblyName").ToString();
 
+	PieceUndoJournal* journal = node_->GetScene()->GetComponent<PieceManager>()->GetUndoJournal();
+	journal->BeginOperation("Duplicate", {});
 
 	Node* pieceNode;
 	if (assemblyName.length()) {
@@ -335,18 +346,23 @@ void ManipulationTool::InstantDuplicatePiece()
 		ea::vector<Node*> children;
 		node_->GetScene()->GetComponent<PieceManager>()->UnPackAssembly(pieceNode, children);
 
+		ea::vector<Piece*> created;
 		for (Node* ch : children) {
 			ch->GetComponent<Piece>()->SetPrimaryColor(aimPiece->GetPrimaryColor());
+			created.push_back(ch->GetComponent<Piece>());
 		}
 
-
+		journal->AddCreatedToOperation(created);
 	}
 	else
 	{
 		pieceNode->GetComponent<Piece>()->SetPrimaryColor(aimPiece->GetPrimaryColor());
 
+		journal->AddCreatedToOperation({ pieceNode->GetComponent<Piece>() });
 	}
 
+	journal->EndOperation();
+
 }
 
 void ManipulationTool::InstantRemovePiece()
@@ -363,10 +379,17 @@ void ManipulationTool::InstantRemovePiece()
 	
 	Node* pieceNode = aimPiece->GetNode();
 
+	node_->GetScene()->GetComponent<PieceManager>()->WakeContraption(aimPiece);
+
+	PieceUndoJournal* journal = node_->GetScene()->GetComponent<PieceManager>()->GetUndoJournal();
+	journal->BeginOperation("Remove", { aimPiece });
+
 	aimPiece->DetachAll();
 
 	pieceNode->Remove();
 
+	journal->EndOperation();
+
 }
 
 void ManipulationTool::drop(bool freeze, bool hadAttachement)
@@ -395,27 +418,41 @@ void ManipulationTool::drop(bool freeze, bool hadAttachement)
 		kinamaticConstriant_ = nullptr;
 	}
 
-	//form new groupings
-	GetScene()->GetComponent<PieceManager>()->FormSolidGroupsOnContraption(gatheredPiece_);
+	//form new groupings off the main thread.  a frozen dropped piece makes its new group frozen when the result is applied.
+	GetScene()->GetComponent<PieceManager>()->RequestAutoFormAllGroups();
 
+	//only the dropped piece's contraption changed - clean and rebuild its branches instead of the whole scene.
+	ea::vector<Piece*> contraptionPieces;
+	gatheredPiece_->GetAttachedPieces(contraptionPieces, true);
+	contraptionPieces.push_back(gatheredPiece_);
+	for (Piece* gatheredPiece : allGatherPieces_)
+	{
+		if (!contraptionPieces.contains(gatheredPiece))
+			contraptionPieces.push_back(gatheredPiece);
+	}
 
-	if (hadAttachement) {
-
-		PieceSolidificationGroup* group = gatheredPiece_->GetPieceGroup();
-		
-		if ((freeze) && group)
-		{
-			group->GetRigidBody()->SetMassScale(0);
-		}
-		
+	ea::vector<WeakPtr<Node>> parents;
+	for (Piece* pc : contraptionPieces)
+	{
+		if (pc->GetNode()->GetParent() != GetScene())
+			parents.push_back(WeakPtr<Node>(pc->GetNode()->GetParent()));
+	}
+	for (Node* parent : parents)
+	{
+		if (parent)
+			GetScene()->GetComponent<PieceManager>()->CleanGroups(parent);
 	}
 
+	ea::vector<Node*> changedNodes;
+	for (Piece* pc : contraptionPieces)
+		changedNodes.push_back(pc->GetNode());
+	GetScene()->GetComponent<PieceManager>()->RebuildSolidifiesBranches(changedNodes);
+
 	gatheredPiece_ = nullptr;
 	gatherPiecePoint_->SetShowBasisIndicator(false);
 	gatherPiecePoint_ = nullptr;
 
-	GetScene()->GetComponent<PieceManager>()->CleanAll();
-	GetScene()->GetComponent<PieceManager>()->RebuildSolidifies();
+	GetScene()->GetComponent<PieceManager>()->GetUndoJournal()->EndOperation();
 
 
 	//restore move mode to camera so that the next picked up piece will get picked up in camera mode.
@@ -800,12 +837,10 @@ void ManipulationTool::UpdateHoverPointIndicators()
 
 	if (pointA) {
 		pointA->SetShowColorIndicator(true, Color::GREEN);
-		hoverPointList_.push_back(WeakPtr<PiecePoint>(pointA));
 		if (pointA->occupiedPoint_) {
 			pointB = pointA->occupiedPoint_;
 			pointA->SetShowColorIndicator(true, Color::MAGENTA);
 			pointB->SetShowColorIndicator(true, Color(0.5f,0.0f,0.5));
-			hoverPointList_.push_back(WeakPtr<PiecePoint>(pointB));
 		}
 	}
 	for (auto point : hoverPointList_)
@@ -814,6 +849,13 @@ void ManipulationTool::UpdateHoverPointIndicators()
 			if (point != pointA && point != pointB)
 				point->SetShowColorIndicator(false, Color::BLUE);
 	}
+
+	//only keep what is currently hovered so the list does not grow every frame.
+	hoverPointList_.clear();
+	if (pointA)
+		hoverPointList_.push_back(WeakPtr<PiecePoint>(pointA));
+	if (pointB)
+		hoverPointList_.push_back(WeakPtr<PiecePoint>(pointB));
 }
 
 void ManipulationTool::UpdateMoveGatherNode()
@@ -868,31 +910,23 @@ void ManipulationTool::UpdateMoveGatherNode()
 		if (IsGathering()) {
 			//cast the gather node forward until it hits something.
 
-			Octree* octree = GetScene()->GetComponent<Octree>();
-			RayOctreeQuery query(Ray(GetEffectiveLookNode()->GetWorldPosition(), GetEffectiveLookNode()->GetWorldDirection()));
-
-			//GetSubsystem<VisualDebugger>()->AddLine(GetEffectiveLookNode()->GetWorldPosition(), GetEffectiveLookNode()->GetWorldPosition() + )
-
-			octree->Raycast(query);
+			//reuse this frame's aim raycast.
+			const ea::vector<RayQueryResult>& results = pieceManager_->GetAimQuery(GetEffectiveLookNode())->GetResults();
 			Vector3 worldPos;
 			bool foundPos = false;
-			for (int i = 0; i < query.result_.size(); i++)
+			for (int i = 0; i < results.size(); i++)
 			{
+				if (results[i].distance_ > gatherNodeMaxCastDist_)
+					break;
 
-				if (query.result_[i].distance_ <= (gatherNodeMaxCastDist_) && query.result_[i].node_->GetName() == "visualNode")
-				{
-					//its a piece..
-					Piece* piece = query.result_[i].node_->GetParent()->GetComponent<Piece>();
-
-					if (piece && !allGatherPieces_.contains(piece))
-					{
-						worldPos = query.result_[i].position_;
-						foundPos = true;
-						break;
-					}
+				Piece* piece = results[i].node_->GetParent() ? results[i].node_->GetParent()->GetComponent<Piece>() : nullptr;
 
+				if (piece && !allGatherPieces_.contains(piece))
+				{
+					worldPos = results[i].position_;
+					foundPos = true;
+					break;
 				}
-
 			}
 
 			if (foundPos) {
@@ -1084,6 +1118,7 @@ void ManipulationTool::CreateGatherNode()
 
 	StaticModel* stMdl = gatherNodeVis->CreateComponent<StaticModel>();
 	stMdl->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/LinePrimitives/Basis.mdl"));
+	stMdl->SetViewMask(DEFAULT_VIEWMASK & ~PIECE_VIEWMASK_PICKABLE);
 }
 
 void ManipulationTool::OnNodeSet(Node* node)
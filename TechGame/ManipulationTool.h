@@ -123,7 +123,7 @@ public:
 		if (piece) {
 
 			piece->SetOiled(false);
-			pieceManager_->FormSolidGroup(piece);
+			pieceManager_->RequestAutoFormAllGroups();
 
 
 
@@ -0,0 +1,88 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+
+bool MappedFile::Open(const ea::string& fileName)
+{
+	Close();
+
+	ea::string nativeName = GetNativePath(fileName);
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(nativeName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	mapHandle_ = mapping;
+	data_ = static_cast<const unsigned char*>(view);
+	size_ = unsigned(size.QuadPart);
+#else
+	int fd = open(nativeName.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	data_ = static_cast<const unsigned char*>(view);
+	size_ = unsigned(info.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!data_)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data_);
+	CloseHandle(mapHandle_);
+#else
+	munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+
+	data_ = nullptr;
+	size_ = 0;
+	mapHandle_ = nullptr;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+//read-only memory mapping of a whole file.  the mapping is released on Close() or destruction.
+class MappedFile
+{
+public:
+
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	///map the file.  returns false if it is missing or empty.
+	bool Open(const ea::string& fileName);
+
+	void Close();
+
+	bool IsOpen() const { return data_ != nullptr; }
+
+	const unsigned char* GetData() const { return data_; }
+
+	unsigned GetSize() const { return size_; }
+
+protected:
+
+	const unsigned char* data_ = nullptr;
+	unsigned size_ = 0;
+	void* mapHandle_ = nullptr;
+};
@@ -0,0 +1,133 @@
+#include "PhysicsContactStream.h"
+#include "Piece.h"
+#include "PieceSolidificationGroup.h"
+#include "Character.h"
+
+#include "NewtonPhysicsWorld.h"
+#include "NewtonPhysicsEvents.h"
+#include "NewtonRigidBody.h"
+
+#include "EASTL/sort.h"
+
+
+
+PhysicsContactStream::PhysicsContactStream(Context* context) : Component(context)
+{
+	SubscribeToEvent(E_NEWTON_PHYSICSCOLLISIONSTART, URHO3D_HANDLER(PhysicsContactStream, HandlePhysicsCollisionStart));
+	SubscribeToEvent(E_NEWTON_PHYSICSPOSTSTEP, URHO3D_HANDLER(PhysicsContactStream, HandlePhysicsPostStep));
+}
+
+void PhysicsContactStream::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PhysicsContactStream>();
+}
+
+unsigned char PhysicsContactStream::GetCategory(NewtonRigidBody* body)
+{
+	if (body->GetMassScale() <= 0.0f)
+		return PhysicsContactCategory_Static;
+
+	Node* node = body->GetNode();
+	if (node->HasComponent<Piece>() || node->HasComponent<PieceSolidificationGroup>())
+		return PhysicsContactCategory_Piece;
+	if (node->HasComponent<Character>())
+		return PhysicsContactCategory_Character;
+
+	return PhysicsContactCategory_Other;
+}
+
+void PhysicsContactStream::HandlePhysicsCollisionStart(StringHash event, VariantMap& eventData)
+{
+	if (!IsEnabledEffective() || GetEventSender() != GetScene()->GetComponent<NewtonPhysicsWorld>())
+		return;
+
+	NewtonRigidBody* bodyA = static_cast<NewtonRigidBody*>(eventData[NewtonPhysicsCollisionStart::P_BODYA].GetPtr());
+	NewtonRigidBody* bodyB = static_cast<NewtonRigidBody*>(eventData[NewtonPhysicsCollisionStart::P_BODYB].GetPtr());
+	if (!bodyA || !bodyB)
+		return;
+
+	pending_.emplace_back();
+	PhysicsContact& contact = pending_.back();
+	contact.bodyA_ = bodyA;
+	contact.bodyB_ = bodyB;
+
+	//the contact data only lives for the event - keep its strongest point.
+	NewtonRigidBodyContactEntry* contactData = static_cast<NewtonRigidBodyContactEntry*>(eventData[NewtonPhysicsCollisionStart::P_CONTACT_DATA].GetPtr());
+	if (contactData && contactData->numContacts > 0)
+	{
+		contact.hasPoints_ = true;
+		contact.position_ = contactData->contactPositions[0];
+		for (int i = 0; i < contactData->numContacts; i++)
+		{
+			float force = contactData->contactForces[i].Length();
+			if (force > contact.force_)
+			{
+				contact.force_ = force;
+				contact.position_ = contactData->contactPositions[i];
+			}
+		}
+	}
+}
+
+void PhysicsContactStream::HandlePhysicsPostStep(StringHash event, VariantMap& eventData)
+{
+	if (GetEventSender() != GetScene()->GetComponent<NewtonPhysicsWorld>())
+		return;
+
+	timeStep_ = eventData[NewtonPhysicsPostStep::P_TIMESTEP].GetFloat();
+
+	//everything that arrived since the last publish - contacts reported after this event go out with the next step.
+	//swap keeps both allocations - nothing is allocated per step once the buffers have grown.
+	contacts_.swap(pending_);
+	pending_.clear();
+	impacts_.clear();
+
+	for (const PhysicsContact& contact : contacts_)
+	{
+		NewtonRigidBody* bodyA = contact.bodyA_;
+		NewtonRigidBody* bodyB = contact.bodyB_;
+		if (!bodyA || !bodyB)
+			continue;
+
+		//cheapest rejections first.
+		unsigned char categoryA = GetCategory(bodyA);
+		unsigned char categoryB = GetCategory(bodyB);
+		if (!((categoryA | categoryB) & categoryMask_) || (categoryA & categoryB & PhysicsContactCategory_Static))
+			continue;
+
+		//closing speed and reduced mass (a static body counts as infinitely heavy) - the rough impulse, used when the solver has no forces yet.
+		float speed = (bodyA->GetLinearVelocity(TS_WORLD) - bodyB->GetLinearVelocity(TS_WORLD)).Length();
+		float massA = categoryA == PhysicsContactCategory_Static ? 0.0f : bodyA->GetEffectiveMass();
+		float massB = categoryB == PhysicsContactCategory_Static ? 0.0f : bodyB->GetEffectiveMass();
+		float reducedMass = massA <= 0.0f ? massB : (massB <= 0.0f ? massA : massA * massB / (massA + massB));
+		float impulse = contact.force_ > 0.0f ? contact.force_ * timeStep_ : reducedMass * speed;
+		if (impulse < impulseThreshold_)
+			continue;
+
+		impacts_.emplace_back();
+		PhysicsImpact& impact = impacts_.back();
+		impact.bodyA_ = bodyA;
+		impact.bodyB_ = bodyB;
+		impact.position_ = contact.hasPoints_ ? contact.position_
+			: (categoryA == PhysicsContactCategory_Static ? bodyB->GetNode()->GetWorldPosition() : bodyA->GetNode()->GetWorldPosition());
+		impact.impulse_ = impulse;
+		impact.speed_ = speed;
+		impact.categoryA_ = categoryA;
+		impact.categoryB_ = categoryB;
+	}
+
+	ea::sort(impacts_.begin(), impacts_.end(), [](const PhysicsImpact& a, const PhysicsImpact& b) { return a.impulse_ > b.impulse_; });
+	if (impacts_.size() > maxImpactsPerStep_)
+		impacts_.resize(maxImpactsPerStep_);
+
+	numSeen_ = contacts_.size();
+	numAccepted_ = impacts_.size();
+
+	if (contacts_.empty())
+		return;
+
+	using namespace PhysicsContacts;
+	VariantMap& data = GetEventDataMap();
+	data[P_STREAM] = this;
+	SendEvent(E_PHYSICSCONTACTS, data);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+class NewtonRigidBody;
+
+/// new contacts of the last physics step are ready (PhysicsContactStream::GetContacts, GetImpacts).  sent by the stream once per step with any.
+URHO3D_EVENT(E_PHYSICSCONTACTS, PhysicsContacts)
+{
+	URHO3D_PARAM(P_STREAM, Stream);//PhysicsContactStream pointer
+}
+
+enum PhysicsContactCategory {
+	PhysicsContactCategory_Piece = 1 << 0,
+	PhysicsContactCategory_Character = 1 << 1,
+	PhysicsContactCategory_Static = 1 << 2,
+	PhysicsContactCategory_Other = 1 << 3,
+	PhysicsContactCategory_All = 0xFF
+};
+
+//a new contact pair as the physics world reported it - not classified or filtered.
+struct PhysicsContact
+{
+	WeakPtr<NewtonRigidBody> bodyA_;
+	WeakPtr<NewtonRigidBody> bodyB_;
+	Vector3 position_;//strongest contact point
+	float force_ = 0.0f;//strongest contact force, 0 while the solver has no force for the pair yet
+	bool hasPoints_ = false;
+};
+
+struct PhysicsImpact
+{
+	WeakPtr<NewtonRigidBody> bodyA_;
+	WeakPtr<NewtonRigidBody> bodyB_;
+	Vector3 position_;
+	float impulse_ = 0.0f;//strongest contact force * step (kg m/s), reduced mass * closing speed while the solver has no force for the pair yet
+	float speed_ = 0.0f;//closing speed (m/s)
+	unsigned char categoryA_ = 0;
+	unsigned char categoryB_ = 0;
+};
+
+
+//the one listener for the physics world's per pair contact events; everything else consumes one batch per physics step.  attach to the scene node.
+//on arrival a pair is only copied into a plain buffer (bodies and its strongest contact point).  after the step the batch is published through
+//GetContacts() and the impacts filtered out of it - pairs where one body matches the category mask and the impulse is over the threshold,
+//sorted by impulse and capped - through GetImpacts(), with a single E_PHYSICSCONTACTS.  the per pair event itself is still built by the physics world.
+class PhysicsContactStream : public Component
+{
+	URHO3D_OBJECT(PhysicsContactStream, Component);
+
+public:
+
+	PhysicsContactStream(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	///pairs where neither body is in one of these categories are dropped.
+	void SetCategoryMask(unsigned mask) { categoryMask_ = mask; }
+	unsigned GetCategoryMask() const { return categoryMask_; }
+
+	void SetImpulseThreshold(float impulse) { impulseThreshold_ = impulse; }
+	float GetImpulseThreshold() const { return impulseThreshold_; }
+
+	///strongest impacts kept per step.
+	void SetMaxImpactsPerStep(unsigned count) { maxImpactsPerStep_ = count; }
+
+	///every new contact pair of the last completed step.
+	const ea::vector<PhysicsContact>& GetContacts() const { return contacts_; }
+
+	///impacts of the last completed step, strongest first.
+	const ea::vector<PhysicsImpact>& GetImpacts() const { return impacts_; }
+
+	///contact pairs seen and accepted in the last step.
+	unsigned GetNumContactsSeen() const { return numSeen_; }
+	unsigned GetNumContactsAccepted() const { return numAccepted_; }
+
+	static unsigned char GetCategory(NewtonRigidBody* body);
+
+protected:
+
+	void HandlePhysicsCollisionStart(StringHash event, VariantMap& eventData);
+	void HandlePhysicsPostStep(StringHash event, VariantMap& eventData);
+
+	unsigned categoryMask_ = PhysicsContactCategory_All;
+	float impulseThreshold_ = 0.5f;
+	unsigned maxImpactsPerStep_ = 64;
+	float timeStep_ = 1.0f / 60.0f;//of the last physics step
+
+	ea::vector<PhysicsContact> pending_;
+	ea::vector<PhysicsContact> contacts_;
+	ea::vector<PhysicsImpact> impacts_;
+
+	unsigned numSeen_ = 0;
+	unsigned numAccepted_ = 0;
+};
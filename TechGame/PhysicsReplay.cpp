@@ -0,0 +1,457 @@
+#include "PhysicsReplay.h"
+#include "PieceManager.h"
+#include "Piece.h"
+#include "PiecePointRow.h"
+
+#include "NewtonPhysicsEvents.h"
+#include "NewtonRigidBody.h"
+
+
+
+//value groups inside PhysicsReplayCodec::Quantized - one mask bit each.
+static const unsigned ReplayGroupStart[] = { 0, 3, 7, 10, 13 };
+
+//keeps quantized values inside what a VLE can carry after zigzag coding of a delta.
+static const int ReplayQuantizedLimit = 1 << 26;
+
+static int QuantizeValue(float value, float scale)
+{
+	return Clamp(RoundToInt(value * scale), -ReplayQuantizedLimit, ReplayQuantizedLimit);
+}
+
+static void WriteZigZag(Serializer& dest, int value)
+{
+	dest.WriteVLE((unsigned(value) << 1) ^ unsigned(value >> 31));
+}
+
+static int ReadZigZag(Deserializer& source)
+{
+	unsigned value = source.ReadVLE();
+	return int(value >> 1) ^ -int(value & 1);
+}
+
+
+
+void PhysicsReplayCodec::SetQuanta(float positionQuantum, float velocityQuantum)
+{
+	positionScale_ = 1.0f / positionQuantum;
+	velocityScale_ = 1.0f / velocityQuantum;
+	Reset();
+}
+
+void PhysicsReplayCodec::Quantize(const PhysicsReplayBodyState& state, Quantized& quantized) const
+{
+	//q and -q are the same rotation - keep w positive so slow rotations give small deltas.
+	Quaternion rotation = state.rotation_.Normalized();
+	if (rotation.w_ < 0.0f)
+		rotation = Quaternion(-rotation.w_, -rotation.x_, -rotation.y_, -rotation.z_);
+
+	int* v = quantized.values_;
+	v[0] = QuantizeValue(state.position_.x_, positionScale_);
+	v[1] = QuantizeValue(state.position_.y_, positionScale_);
+	v[2] = QuantizeValue(state.position_.z_, positionScale_);
+	v[3] = QuantizeValue(rotation.w_, 32767.0f);
+	v[4] = QuantizeValue(rotation.x_, 32767.0f);
+	v[5] = QuantizeValue(rotation.y_, 32767.0f);
+	v[6] = QuantizeValue(rotation.z_, 32767.0f);
+	v[7] = QuantizeValue(state.linearVelocity_.x_, velocityScale_);
+	v[8] = QuantizeValue(state.linearVelocity_.y_, velocityScale_);
+	v[9] = QuantizeValue(state.linearVelocity_.z_, velocityScale_);
+	v[10] = QuantizeValue(state.angularVelocity_.x_, velocityScale_);
+	v[11] = QuantizeValue(state.angularVelocity_.y_, velocityScale_);
+	v[12] = QuantizeValue(state.angularVelocity_.z_, velocityScale_);
+}
+
+void PhysicsReplayCodec::Dequantize(const Quantized& quantized, PhysicsReplayBodyState& state) const
+{
+	const int* v = quantized.values_;
+	state.position_ = Vector3(float(v[0]), float(v[1]), float(v[2])) / positionScale_;
+	state.rotation_ = Quaternion(v[3] / 32767.0f, v[4] / 32767.0f, v[5] / 32767.0f, v[6] / 32767.0f).Normalized();
+	state.linearVelocity_ = Vector3(float(v[7]), float(v[8]), float(v[9])) / velocityScale_;
+	state.angularVelocity_ = Vector3(float(v[10]), float(v[11]), float(v[12])) / velocityScale_;
+}
+
+void PhysicsReplayCodec::Encode(const PhysicsReplayBodyState& state, Serializer& dest)
+{
+	Quantized quantized;
+	Quantize(state, quantized);
+
+	Quantized& last = last_[state.nodeId_];
+
+	unsigned char mask = 0;
+	for (unsigned g = 0; g < 4; g++)
+	{
+		for (unsigned i = ReplayGroupStart[g]; i < ReplayGroupStart[g + 1]; i++)
+		{
+			if (quantized.values_[i] != last.values_[i])
+			{
+				mask |= 1 << g;
+				break;
+			}
+		}
+	}
+
+	//resting bodies cost one byte.
+	dest.WriteUByte(mask);
+	for (unsigned g = 0; g < 4; g++)
+	{
+		if (!(mask & (1 << g)))
+			continue;
+
+		for (unsigned i = ReplayGroupStart[g]; i < ReplayGroupStart[g + 1]; i++)
+			WriteZigZag(dest, quantized.values_[i] - last.values_[i]);
+	}
+
+	last = quantized;
+}
+
+void PhysicsReplayCodec::Decode(unsigned nodeId, Deserializer& source, PhysicsReplayBodyState& state)
+{
+	Quantized& last = last_[nodeId];
+
+	unsigned char mask = source.ReadUByte();
+	for (unsigned g = 0; g < 4; g++)
+	{
+		if (!(mask & (1 << g)))
+			continue;
+
+		for (unsigned i = ReplayGroupStart[g]; i < ReplayGroupStart[g + 1]; i++)
+			last.values_[i] += ReadZigZag(source);
+	}
+
+	state.nodeId_ = nodeId;
+	Dequantize(last, state);
+}
+
+
+
+PhysicsReplayRecorder::PhysicsReplayRecorder(Context* context) : Component(context)
+{
+	codec_.SetQuanta(positionQuantum_, velocityQuantum_);
+	SubscribeToEvent(E_NEWTON_PHYSICSPOSTSTEP, URHO3D_HANDLER(PhysicsReplayRecorder, HandlePhysicsPostStep));
+	SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(PhysicsReplayRecorder, HandlePostUpdate));
+}
+
+void PhysicsReplayRecorder::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PhysicsReplayRecorder>();
+}
+
+void PhysicsReplayRecorder::SetRecording(bool enable)
+{
+	if (enable && !recording_)
+		Clear();
+
+	recording_ = enable;
+}
+
+void PhysicsReplayRecorder::SetQuanta(float positionQuantum, float velocityQuantum)
+{
+	positionQuantum_ = positionQuantum;
+	velocityQuantum_ = velocityQuantum;
+	codec_.SetQuanta(positionQuantum_, velocityQuantum_);
+	Clear();
+}
+
+void PhysicsReplayRecorder::Clear()
+{
+	segments_.clear();
+	pendingEvents_.clear();
+	memoryUse_ = 0;
+	step_ = 0;
+	segmentsSinceScene_ = 0;
+	scenePending_ = false;
+	codec_.Reset();
+}
+
+void PhysicsReplayRecorder::RecordEvent(PhysicsReplayEventType type, PiecePointRow* rowA, PiecePointRow* rowB)
+{
+	if (!recording_)
+		return;
+
+	PhysicsReplayEvent event;
+	event.type_ = type;
+	event.rows_[0] = rowA->GetID();
+	event.rows_[1] = rowB->GetID();
+	pendingEvents_.push_back(event);
+}
+
+void PhysicsReplayRecorder::BeginSegment(bool saveScene)
+{
+	if (segments_.size())
+		memoryUse_ += segments_.back()->data_.GetSize() + segments_.back()->scene_.GetSize();
+
+	//drop whole segments from the front - every segment starts with a keyframe so the rest still decodes.  the ring must also
+	//start where a scene was saved, so after trimming the segments up to the next saved scene go as well.
+	bool trimmed = false;
+	while (segments_.size() && (memoryUse_ > maxMemory_ || (trimmed && !segments_.front()->scene_.GetSize())))
+	{
+		memoryUse_ -= segments_.front()->data_.GetSize() + segments_.front()->scene_.GetSize();
+		freeSegment_ = segments_.front();
+		segments_.pop_front();
+		trimmed = true;
+	}
+
+	SharedPtr<Segment> segment = freeSegment_ ? freeSegment_ : SharedPtr<Segment>(new Segment());
+	freeSegment_ = nullptr;
+
+	//Clear keeps the allocation of a recycled segment.
+	segment->data_.Clear();
+	segment->scene_.Clear();
+	segment->firstStep_ = step_;
+	segment->numFrames_ = 0;
+	segments_.push_back(segment);
+
+	//saved between frames, so it is the state the segment's first step starts from.  merges are undone for the save like any other.
+	if (saveScene)
+	{
+		PieceManager* pieceManager = GetScene()->GetComponent<PieceManager>();
+		if (pieceManager)
+			pieceManager->BeginSceneSave();
+		GetScene()->Save(segment->scene_);
+		if (pieceManager)
+			pieceManager->EndSceneSave();
+
+		segmentsSinceScene_ = 0;
+	}
+	else
+		segmentsSinceScene_++;
+
+	codec_.Reset();
+}
+
+void PhysicsReplayRecorder::HandlePhysicsPostStep(StringHash event, VariantMap& eventData)
+{
+	if (!recording_ || !GetScene())
+		return;
+
+	PieceManager* pieceManager = GetScene()->GetComponent<PieceManager>();
+	if (!pieceManager)
+		return;
+
+	//the ring starts at a saved scene - nothing is recorded until the first one is taken after this frame.
+	if (segments_.empty())
+	{
+		scenePending_ = true;
+		return;
+	}
+
+	HiresTimer timer;
+
+	//a segment due to start with a scene runs on until the frame's steps are done.
+	if (segments_.back()->numFrames_ >= keyframeInterval_ && !scenePending_)
+	{
+		if (segmentsSinceScene_ + 1 >= sceneKeyframeInterval_)
+			scenePending_ = true;
+		else
+			BeginSegment(false);
+	}
+
+	Segment* segment = segments_.back();
+	VectorBuffer& dest = segment->data_;
+
+	dest.WriteVLE(step_);
+
+	dest.WriteVLE(pendingEvents_.size());
+	for (const PhysicsReplayEvent& replayEvent : pendingEvents_)
+	{
+		dest.WriteUByte(replayEvent.type_);
+		dest.WriteVLE(replayEvent.rows_[0]);
+		dest.WriteVLE(replayEvent.rows_[1]);
+	}
+	pendingEvents_.clear();
+
+	const ea::vector<Piece*>& pieces = pieceManager->GetAllPieces();
+	dest.WriteVLE(pieces.size());
+
+	//registry order is stable between steps so node id deltas stay small.
+	unsigned lastNodeId = 0;
+	PhysicsReplayBodyState state;
+	for (Piece* piece : pieces)
+	{
+		Node* node = piece->GetNode();
+		state.nodeId_ = node->GetID();
+		state.position_ = node->GetWorldPosition();
+		state.rotation_ = node->GetWorldRotation();
+
+		NewtonRigidBody* body = piece->GetEffectiveRigidBody();
+		state.linearVelocity_ = body ? body->GetLinearVelocity(TS_WORLD) : Vector3::ZERO;
+		state.angularVelocity_ = body ? body->GetAngularVelocity(TS_WORLD) : Vector3::ZERO;
+
+		WriteZigZag(dest, int(state.nodeId_ - lastNodeId));
+		lastNodeId = state.nodeId_;
+
+		codec_.Encode(state, dest);
+	}
+
+	segment->numFrames_++;
+	step_++;
+
+	lastStepUSec_ = timer.GetUSec(false);
+}
+
+void PhysicsReplayRecorder::HandlePostUpdate(StringHash event, VariantMap& eventData)
+{
+	if (!recording_ || !scenePending_ || !GetScene())
+		return;
+
+	scenePending_ = false;
+
+	HiresTimer timer;
+	BeginSegment(true);
+	lastSceneUSec_ = timer.GetUSec(false);
+}
+
+bool PhysicsReplayRecorder::Dump(Serializer& dest) const
+{
+	bool success = dest.WriteFileID(PHYSICSREPLAY_FILEID);
+	success &= dest.WriteUInt(PHYSICSREPLAY_VERSION);
+	success &= dest.WriteFloat(positionQuantum_);
+	success &= dest.WriteFloat(velocityQuantum_);
+
+	success &= dest.WriteVLE(segments_.size());
+	for (const SharedPtr<Segment>& segment : segments_)
+	{
+		success &= dest.WriteVLE(segment->numFrames_);
+		success &= dest.WriteBuffer(segment->data_.GetBuffer());
+	}
+
+	//the scene the oldest segment starts from - trimming keeps the ring starting at a saved scene.
+	if (segments_.size())
+		success &= dest.WriteBuffer(segments_.front()->scene_.GetBuffer());
+	else
+		success &= dest.WriteVLE(0);
+
+	return success;
+}
+
+bool PhysicsReplayRecorder::DumpFile(const ea::string& fileName) const
+{
+	File file(context_, fileName, FILE_WRITE);
+	if (!file.IsOpen())
+		return false;
+
+	return Dump(file);
+}
+
+
+
+PhysicsReplayPlayer::PhysicsReplayPlayer(Context* context) : Object(context)
+{
+}
+
+bool PhysicsReplayPlayer::Open(const ea::string& fileName)
+{
+	segments_.clear();
+	sceneData_.clear();
+	numFrames_ = 0;
+
+	File file(context_, fileName, FILE_READ);
+	if (!file.IsOpen() || file.ReadFileID() != PHYSICSREPLAY_FILEID || file.ReadUInt() != PHYSICSREPLAY_VERSION)
+	{
+		URHO3D_LOGWARNING("PhysicsReplayPlayer: " + fileName + " is not a replay of the current version");
+		return false;
+	}
+
+	float positionQuantum = file.ReadFloat();
+	float velocityQuantum = file.ReadFloat();
+	if (positionQuantum <= 0.0f || velocityQuantum <= 0.0f)
+		return false;
+
+	codec_.SetQuanta(positionQuantum, velocityQuantum);
+
+	unsigned numSegments = file.ReadVLE();
+	for (unsigned i = 0; i < numSegments && !file.IsEof(); i++)
+	{
+		Segment segment;
+		segment.numFrames_ = file.ReadVLE();
+		segment.data_ = file.ReadBuffer();
+		numFrames_ += segment.numFrames_;
+		segments_.push_back(ea::move(segment));
+	}
+	sceneData_ = file.ReadBuffer();
+
+	Rewind();
+	return true;
+}
+
+bool PhysicsReplayPlayer::LoadScene(Scene* scene)
+{
+	if (sceneData_.empty())
+		return false;
+
+	MemoryBuffer source(sceneData_);
+	if (!scene->Load(source))
+		return false;
+
+	//keyframe scenes are saved mid-run - collision merges have piece shapes disabled in them.
+	if (PieceManager* pieceManager = scene->GetComponent<PieceManager>())
+		pieceManager->SetupAfterSceneLoad();
+
+	scene_ = scene;
+	return true;
+}
+
+void PhysicsReplayPlayer::Rewind()
+{
+	segment_ = 0;
+	frameInSegment_ = 0;
+	readOffset_ = 0;
+	codec_.Reset();
+}
+
+bool PhysicsReplayPlayer::StepFrame()
+{
+	while (segment_ < segments_.size() && frameInSegment_ >= segments_[segment_].numFrames_)
+	{
+		segment_++;
+		frameInSegment_ = 0;
+		readOffset_ = 0;
+		codec_.Reset();
+	}
+
+	if (segment_ >= segments_.size())
+		return false;
+
+	const Segment& segment = segments_[segment_];
+	MemoryBuffer source(segment.data_.data(), segment.data_.size());
+	source.Seek(readOffset_);
+
+	frameStep_ = source.ReadVLE();
+
+	frameEvents_.resize(source.ReadVLE());
+	for (PhysicsReplayEvent& replayEvent : frameEvents_)
+	{
+		replayEvent.type_ = source.ReadUByte();
+		replayEvent.rows_[0] = source.ReadVLE();
+		replayEvent.rows_[1] = source.ReadVLE();
+	}
+
+	frameBodies_.resize(source.ReadVLE());
+	unsigned nodeId = 0;
+	for (PhysicsReplayBodyState& state : frameBodies_)
+	{
+		nodeId += ReadZigZag(source);
+		codec_.Decode(nodeId, source, state);
+	}
+
+	if (source.IsEof() && frameInSegment_ + 1 < segment.numFrames_)
+	{
+		URHO3D_LOGWARNING("PhysicsReplayPlayer: truncated segment");
+		frameInSegment_ = segment.numFrames_;
+	}
+
+	readOffset_ = source.GetPosition();
+	frameInSegment_++;
+
+	if (scene_)
+	{
+		for (const PhysicsReplayBodyState& state : frameBodies_)
+		{
+			if (Node* node = scene_->GetNode(state.nodeId_))
+				node->SetWorldTransform(state.position_, state.rotation_);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+class PiecePointRow;
+
+#define PHYSICSREPLAY_FILEID "PRPL"
+#define PHYSICSREPLAY_VERSION 2
+
+
+enum PhysicsReplayEventType {
+	PhysicsReplayEvent_Attach = 0,
+	PhysicsReplayEvent_Detach
+};
+
+//attach/detach between two rows, by row component id.
+struct PhysicsReplayEvent
+{
+	unsigned char type_ = PhysicsReplayEvent_Attach;
+	unsigned rows_[2] = { 0, 0 };
+};
+
+struct PhysicsReplayBodyState
+{
+	unsigned nodeId_ = 0;
+	Vector3 position_;
+	Quaternion rotation_;
+	Vector3 linearVelocity_;
+	Vector3 angularVelocity_;
+};
+
+
+//quantizer and delta coder shared by recorder and player.  each body is coded against its own previous state; Reset() at keyframes.
+class PhysicsReplayCodec
+{
+public:
+
+	void SetQuanta(float positionQuantum, float velocityQuantum);
+
+	void Reset() { last_.clear(); }
+
+	void Encode(const PhysicsReplayBodyState& state, Serializer& dest);
+	void Decode(unsigned nodeId, Deserializer& source, PhysicsReplayBodyState& state);
+
+protected:
+
+	struct Quantized {
+		int values_[13] = {};//position 3, rotation 4, linear velocity 3, angular velocity 3
+	};
+
+	void Quantize(const PhysicsReplayBodyState& state, Quantized& quantized) const;
+	void Dequantize(const Quantized& quantized, PhysicsReplayBodyState& state) const;
+
+	float positionScale_ = 1024.0f;
+	float velocityScale_ = 256.0f;
+
+	ea::hash_map<unsigned, Quantized> last_;
+};
+
+
+//records the transform and velocity of every piece each physics step, plus row attach/detach events, into a ring of
+//keyframed segments bounded by memory.  every few segments also start with a saved scene; the ring always begins at one of them,
+//so Dump() writes the scene the oldest segment starts from, not the one at dump time, for PhysicsReplayPlayer.  scenes are saved after
+//the frame's physics steps (E_POSTUPDATE), never inside one.  attach to the scene node.
+class PhysicsReplayRecorder : public Component
+{
+	URHO3D_OBJECT(PhysicsReplayRecorder, Component);
+
+public:
+
+	PhysicsReplayRecorder(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	void SetRecording(bool enable);
+	bool IsRecording() const { return recording_; }
+
+	///quantum of positions (m) and velocities (m/s or rad/s).  changing them restarts the recording.
+	void SetQuanta(float positionQuantum, float velocityQuantum);
+
+	///steps between keyframes.  older history is dropped a whole segment (keyframe interval) at a time.
+	void SetKeyframeInterval(unsigned steps) { keyframeInterval_ = Max(steps, 1u); }
+
+	///segments between saved scenes.  history is dropped from the front a whole scene interval at a time.
+	void SetSceneKeyframeInterval(unsigned segments) { sceneKeyframeInterval_ = Max(segments, 1u); }
+
+	///recorded history is trimmed to roughly this many bytes.
+	void SetMaxMemory(unsigned bytes) { maxMemory_ = bytes; }
+	unsigned GetMemoryUse() const { return memoryUse_; }
+
+	void Clear();
+
+	///called by PiecePointRow when rows are attached or detached.  the event is written with the next step.
+	void RecordEvent(PhysicsReplayEventType type, PiecePointRow* rowA, PiecePointRow* rowB);
+
+	bool Dump(Serializer& dest) const;
+	bool DumpFile(const ea::string& fileName) const;
+
+	///cost of the last recorded step in microseconds.
+	long long GetLastStepUSec() const { return lastStepUSec_; }
+
+	///cost of the last saved scene in microseconds.  not part of any step.
+	long long GetLastSceneUSec() const { return lastSceneUSec_; }
+
+protected:
+
+	struct Segment : public RefCounted {
+		VectorBuffer data_;
+		VectorBuffer scene_;//saved scene at the start of the segment, empty on most.
+		unsigned firstStep_ = 0;
+		unsigned numFrames_ = 0;
+	};
+
+	void BeginSegment(bool saveScene);
+
+	void HandlePhysicsPostStep(StringHash event, VariantMap& eventData);
+
+	void HandlePostUpdate(StringHash event, VariantMap& eventData);
+
+	bool recording_ = false;
+
+	float positionQuantum_ = 1.0f / 1024.0f;
+	float velocityQuantum_ = 1.0f / 256.0f;
+	unsigned keyframeInterval_ = 120;
+	unsigned sceneKeyframeInterval_ = 8;
+	unsigned segmentsSinceScene_ = 0;
+	bool scenePending_ = false;//the next segment starts with a saved scene once the frame's steps are done.
+	unsigned maxMemory_ = 64 * 1024 * 1024;
+	unsigned memoryUse_ = 0;//finished segments only
+
+	PhysicsReplayCodec codec_;
+	ea::deque<SharedPtr<Segment>> segments_;
+	SharedPtr<Segment> freeSegment_;
+	unsigned step_ = 0;
+
+	ea::vector<PhysicsReplayEvent> pendingEvents_;
+
+	long long lastStepUSec_ = 0;
+	long long lastSceneUSec_ = 0;
+};
+
+
+//plays a PhysicsReplayRecorder dump back onto a scene by node id, one step per StepFrame() call, with no physics running.
+//intended for a headless run that steps as fast as it can and inspects the decoded frames.
+class PhysicsReplayPlayer : public Object
+{
+	URHO3D_OBJECT(PhysicsReplayPlayer, Object);
+
+public:
+
+	PhysicsReplayPlayer(Context* context);
+
+	bool Open(const ea::string& fileName);
+
+	///replace the contents of scene with the scene stored in the dump and play onto it.
+	bool LoadScene(Scene* scene);
+
+	///play onto an already populated scene.
+	void SetScene(Scene* scene) { scene_ = scene; }
+
+	///decode the next step and move the scene's nodes to it.  returns false at the end of the recording.
+	bool StepFrame();
+
+	///back to the oldest recorded step.
+	void Rewind();
+
+	unsigned GetNumFrames() const { return numFrames_; }
+
+	unsigned GetFrameStep() const { return frameStep_; }
+	const ea::vector<PhysicsReplayEvent>& GetFrameEvents() const { return frameEvents_; }
+	const ea::vector<PhysicsReplayBodyState>& GetFrameBodies() const { return frameBodies_; }
+
+protected:
+
+	struct Segment {
+		ea::vector<unsigned char> data_;
+		unsigned numFrames_ = 0;
+	};
+
+	ea::vector<Segment> segments_;
+	ea::vector<unsigned char> sceneData_;
+	unsigned numFrames_ = 0;
+
+	PhysicsReplayCodec codec_;
+	unsigned segment_ = 0;
+	unsigned frameInSegment_ = 0;
+	unsigned readOffset_ = 0;
+
+	WeakPtr<Scene> scene_;
+
+	unsigned frameStep_ = 0;
+	ea::vector<PhysicsReplayEvent> frameEvents_;
+	ea::vector<PhysicsReplayBodyState> frameBodies_;
+};
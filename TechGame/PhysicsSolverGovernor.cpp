@@ -0,0 +1,171 @@
+#include "PhysicsSolverGovernor.h"
+
+#include "NewtonPhysicsWorld.h"
+#include "NewtonPhysicsEvents.h"
+
+
+
+PhysicsSolverGovernor::PhysicsSolverGovernor(Context* context) : Component(context)
+{
+	SubscribeToEvent(E_NEWTON_PHYSICSPRESTEP, URHO3D_HANDLER(PhysicsSolverGovernor, HandlePhysicsPreStep));
+	SubscribeToEvent(E_NEWTON_PHYSICSPOSTSTEP, URHO3D_HANDLER(PhysicsSolverGovernor, HandlePhysicsPostStep));
+}
+
+void PhysicsSolverGovernor::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PhysicsSolverGovernor>();
+}
+
+void PhysicsSolverGovernor::SetIterationRange(int minIterations, int maxIterations)
+{
+	minIterations_ = Max(minIterations, 1);
+	maxIterations_ = Max(maxIterations, minIterations_);
+	if (iterations_)
+	{
+		iterations_ = Clamp(iterations_, minIterations_, maxIterations_);
+		Apply("iteration range changed");
+	}
+}
+
+void PhysicsSolverGovernor::SetSubStepRange(int minSubSteps, int maxSubSteps)
+{
+	minSubSteps_ = Max(minSubSteps, 1);
+	maxSubSteps_ = Max(maxSubSteps, minSubSteps_);
+	if (subSteps_)
+	{
+		subSteps_ = Clamp(subSteps_, minSubSteps_, maxSubSteps_);
+		Apply("substep range changed");
+	}
+}
+
+void PhysicsSolverGovernor::OnSceneSet(Scene* scene)
+{
+	if (!scene)
+	{
+		Restore();
+		physicsWorld_ = nullptr;
+		return;
+	}
+
+	physicsWorld_ = scene->GetComponent<NewtonPhysicsWorld>();
+	if (!physicsWorld_)
+	{
+		URHO3D_LOGWARNING("PhysicsSolverGovernor: no physics world in the scene - add the governor after it");
+		return;
+	}
+
+	//the world's own settings are the quality ceiling and the start - the governor only ever gives quality up to hold the budget.
+	maxIterations_ = Max(physicsWorld_->GetNewtonWorld()->GetSolverIterations(), 1);
+	maxSubSteps_ = Max(physicsWorld_->GetNewtonWorld()->GetSubSteps(), 1);
+	minIterations_ = Min(minIterations_, maxIterations_);
+	minSubSteps_ = Min(minSubSteps_, maxSubSteps_);
+
+	iterations_ = maxIterations_;
+	subSteps_ = maxSubSteps_;
+	windowUSec_ = 0;
+	windowSteps_ = 0;
+	Apply("start");
+}
+
+void PhysicsSolverGovernor::OnSetEnabled()
+{
+	windowUSec_ = 0;
+	windowSteps_ = 0;
+
+	if (!IsEnabledEffective())
+	{
+		Restore();
+		return;
+	}
+
+	iterations_ = maxIterations_;
+	subSteps_ = maxSubSteps_;
+	Apply("enabled");
+}
+
+void PhysicsSolverGovernor::Restore()
+{
+	if (!physicsWorld_ || !iterations_)
+		return;
+
+	physicsWorld_->GetNewtonWorld()->SetSolverIterations(maxIterations_);
+	physicsWorld_->GetNewtonWorld()->SetSubSteps(maxSubSteps_);
+	URHO3D_LOGINFO("PhysicsSolverGovernor: released -> " + ea::to_string(maxIterations_) + " iterations, " + ea::to_string(maxSubSteps_) + " substeps");
+}
+
+void PhysicsSolverGovernor::Apply(const ea::string& reason)
+{
+	if (!physicsWorld_)
+		return;
+
+	physicsWorld_->GetNewtonWorld()->SetSolverIterations(iterations_);
+	physicsWorld_->GetNewtonWorld()->SetSubSteps(subSteps_);
+
+	PhysicsSolverDecision decision;
+	decision.step_ = step_;
+	decision.averageUSec_ = averageUSec_;
+	decision.iterations_ = iterations_;
+	decision.subSteps_ = subSteps_;
+	decision.reason_ = reason;
+
+	if (decisions_.size() >= MAX_DECISIONS)
+		decisions_.erase(decisions_.begin());
+	decisions_.push_back(decision);
+
+	URHO3D_LOGINFO("PhysicsSolverGovernor: " + reason + " (avg " + ea::to_string(averageUSec_) + " us, budget " + ea::to_string(budgetUSec_)
+		+ " us) -> " + ea::to_string(iterations_) + " iterations, " + ea::to_string(subSteps_) + " substeps");
+}
+
+void PhysicsSolverGovernor::HandlePhysicsPreStep(StringHash event, VariantMap& eventData)
+{
+	if (!IsEnabledEffective() || GetEventSender() != GetScene()->GetComponent<NewtonPhysicsWorld>())
+		return;
+
+	stepTimer_.Reset();
+}
+
+void PhysicsSolverGovernor::HandlePhysicsPostStep(StringHash event, VariantMap& eventData)
+{
+	if (!IsEnabledEffective() || GetEventSender() != GetScene()->GetComponent<NewtonPhysicsWorld>())
+		return;
+
+	step_++;
+	windowUSec_ += stepTimer_.GetUSec(false);
+	windowSteps_++;
+	if (windowSteps_ < window_)
+		return;
+
+	averageUSec_ = windowUSec_ / windowSteps_;
+	windowUSec_ = 0;
+	windowSteps_ = 0;
+
+	//one notch per window - the next window measures the effect before anything else changes.
+	if (averageUSec_ > budgetUSec_)
+	{
+		if (iterations_ > minIterations_)
+		{
+			iterations_--;
+			Apply("over budget, fewer iterations");
+		}
+		else if (subSteps_ > minSubSteps_)
+		{
+			subSteps_--;
+			Apply("over budget, fewer substeps");
+		}
+	}
+	else
+	{
+		//raise only if the step is expected to stay under the headroom afterwards (cost scales about linearly with both), otherwise it would just flip back.
+		long long target = (long long)(budgetUSec_ * headroom_);
+		if (subSteps_ < maxSubSteps_ && averageUSec_ * (subSteps_ + 1) / subSteps_ < target)
+		{
+			subSteps_++;
+			Apply("under budget, more substeps");
+		}
+		else if (iterations_ < maxIterations_ && averageUSec_ * (iterations_ + 1) / iterations_ < target)
+		{
+			iterations_++;
+			Apply("under budget, more iterations");
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+class NewtonPhysicsWorld;
+
+//one adjustment made by PhysicsSolverGovernor.
+struct PhysicsSolverDecision
+{
+	unsigned step_ = 0;
+	long long averageUSec_ = 0;
+	int iterations_ = 0;
+	int subSteps_ = 0;
+
+	ea::string reason_;
+};
+
+
+//holds the physics step inside a time budget by trading solver quality for speed.  attach to the scene node after the physics world.
+//the world's iterations and substeps when the governor is added are the top of its ranges and where it starts; disabling or removing
+//the governor puts them back.  the step time is averaged over a window of steps; over budget the solver iterations are lowered first, then the substeps.
+//when the step would still fit in budget * headroom after a raise, the substeps come back first, then the iterations.  every change is logged and kept in GetDecisions().
+//without it a heavy build takes longer to step than it simulates and the fixed step loop never catches up.
+class PhysicsSolverGovernor : public Component
+{
+	URHO3D_OBJECT(PhysicsSolverGovernor, Component);
+
+public:
+
+	PhysicsSolverGovernor(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	///budget for one physics step in microseconds.
+	void SetBudgetUSec(long long usec) { budgetUSec_ = Max(usec, 1ll); }
+	long long GetBudgetUSec() const { return budgetUSec_; }
+
+	///override the ranges taken from the world.  call once the governor is in the scene.
+	void SetIterationRange(int minIterations, int maxIterations);
+	void SetSubStepRange(int minSubSteps, int maxSubSteps);
+
+	///steps averaged per decision.
+	void SetWindow(unsigned steps) { window_ = Max(steps, 1u); }
+
+	///quality is raised again only if the predicted step time stays under budget * headroom.
+	void SetHeadroom(float headroom) { headroom_ = Clamp(headroom, 0.0f, 1.0f); }
+
+	int GetIterations() const { return iterations_; }
+	int GetSubSteps() const { return subSteps_; }
+	long long GetAverageUSec() const { return averageUSec_; }
+
+	///most recent decisions, oldest first.
+	const ea::vector<PhysicsSolverDecision>& GetDecisions() const { return decisions_; }
+
+	static const unsigned MAX_DECISIONS = 32;
+
+protected:
+
+	void Apply(const ea::string& reason);
+
+	//put the world back to the top of the ranges.
+	void Restore();
+
+	virtual void OnSceneSet(Scene* scene) override;
+	virtual void OnSetEnabled() override;
+
+	void HandlePhysicsPreStep(StringHash event, VariantMap& eventData);
+	void HandlePhysicsPostStep(StringHash event, VariantMap& eventData);
+
+	long long budgetUSec_ = 8000;
+	int minIterations_ = 2;
+	int maxIterations_ = 8;
+	int minSubSteps_ = 1;
+	int maxSubSteps_ = 2;
+	unsigned window_ = 30;
+	float headroom_ = 0.6f;
+
+	WeakPtr<NewtonPhysicsWorld> physicsWorld_;
+
+	int iterations_ = 0;
+	int subSteps_ = 0;
+
+	HiresTimer stepTimer_;
+	long long windowUSec_ = 0;
+	unsigned windowSteps_ = 0;
+	long long averageUSec_ = 0;
+	unsigned step_ = 0;
+
+	ea::vector<PhysicsSolverDecision> decisions_;
+};
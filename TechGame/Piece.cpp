@@ -22,6 +22,7 @@ void Piece::RegisterObject(Context* context)
 	URHO3D_ACCESSOR_ATTRIBUTE(PIECE_ATTRIB_PRIMARY_GHOST, GetGhostingEffectEnabled, SetGhostingEffectEnabled, bool, false, AM_DEFAULT);
 	URHO3D_ACCESSOR_ATTRIBUTE(PIECE_ATTRIB_PRIMARY_COLOR, GetPrimaryColor, SetPrimaryColor, Color, Color::BLUE, AM_DEFAULT);
 	URHO3D_ACCESSOR_ATTRIBUTE(PIECE_ATTRIB_PRIMARY_DYNAMIC_ATTACH, GetEnableDynamicDetachment, SetEnableDynamicDetachmentAttrib, bool, true, AM_DEFAULT);
+	URHO3D_ATTRIBUTE(PIECE_ATTRIB_JOURNAL_ID, unsigned, journalId_, 0, AM_FILE);
 
 
 
@@ -70,6 +71,8 @@ bool Piece::AddAssemblyPiece(Piece* piece)
 {
 	if (piece != this) {
 		assemblyPieces_.push_back(piece);
+		if (registryHandle_.manager_)
+			registryHandle_.manager_->MarkContraptionsDirty();
 		return true;
 	}
 	else
@@ -148,7 +151,14 @@ void Piece::RefreshVisualMaterial()
 
 	resolvedMaterial->SetShaderParameter("UOffset", Vector4(0.5, 0.0f, 1.0f, 1.0f));
 	resolvedMaterial->SetShaderParameter("VOffset", Vector4(0.0f, 0.5f, 1.0f, 1.0f));
-	
+
+	//any merged group this piece is drawn in needs the new look.
+	for (Node* curNode = node_->GetParent(); curNode; curNode = curNode->GetParent())
+	{
+		PieceSolidificationGroup* group = curNode->GetComponent<PieceSolidificationGroup>();
+		if (group)
+			group->MarkRenderMergeDirty();
+	}
 }
 
 void Piece::GetAttachedPiecesRec(ea::vector<Piece*>& pieces, bool recursive)
@@ -270,7 +280,7 @@ void Piece::ReAttachAll()
 		row->ReAttachAll();
 	}
 
-	GetScene()->GetComponent<PieceManager>()->AutoFormAllGroups();
+	GetScene()->GetComponent<PieceManager>()->RequestAutoFormAllGroups();
 }
 
 bool Piece::IsEffectivelySolidified()
@@ -318,12 +328,15 @@ void Piece::ApplyAttributes()
 void Piece::OnNodeSet(Node* node)
 {
 	if (node) {
-
-
+		PieceManager::RegisterComponent(this);
+		if (registryHandle_.manager_)
+			registryHandle_.manager_->MarkContraptionsDirty();
 	}
 	else
 	{
-
+		if (registryHandle_.manager_)
+			registryHandle_.manager_->MarkContraptionsDirty();
+		PieceManager::UnRegisterComponent(this);
 	}
 }
 
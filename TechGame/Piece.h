@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Urho3D/Urho3DAll.h>
+#include "PieceManager.h"
 #include "Urho3D/IO/Log.h"
 
 #include "NewtonPhysicsWorld.h"
@@ -18,6 +19,7 @@ class PieceSolidificationGroup;
 
 #define PIECE_ATTRIB_PRIMARY_COLOR "Primary Color"
 #define PIECE_ATTRIB_PRIMARY_GHOST "Ghosting Effect"
+#define PIECE_ATTRIB_JOURNAL_ID "Journal Id"
 #define PIECE_ATTRIB_PRIMARY_DYNAMIC_ATTACH "Dynamic Detachement"
 
 
@@ -70,6 +72,9 @@ public:
 		}
 	}
 
+	StringHash GetColorPalletId() const { return colorPalletId_; }
+	bool GetUseColorPallet() const { return useColorPallet_; }
+
 	bool IsOiled() const { return oiled_; }
 	void SetOiled(bool enable) { oiled_ = enable; }
 	
@@ -109,6 +114,15 @@ public:
 
 
 
+	//slot in the PieceManager registry (maintained in OnNodeSet).
+	PieceRegistryHandle registryHandle_;
+
+	//stable id used by PieceUndoJournal (0 = not journaled yet).
+	unsigned journalId_ = 0;
+
+	//contraption (set of connected pieces) this piece belongs to - maintained by PieceManager::UpdateContraptionIds.
+	unsigned contraptionId_ = 0;
+
 protected:
 
 
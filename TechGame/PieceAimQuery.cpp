@@ -0,0 +1,101 @@
+#include "PieceAimQuery.h"
+#include "Piece.h"
+
+#include "VisualDebugger.h"
+
+
+
+PieceAimQuery::PieceAimQuery(Context* context) : Component(context)
+{
+	SubscribeToEvent(E_NODEREMOVED, URHO3D_HANDLER(PieceAimQuery, HandleNodeRemoved));
+}
+
+void PieceAimQuery::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PieceAimQuery>();
+}
+
+Piece* PieceAimQuery::GetAimPiece(Vector3& worldPos)
+{
+	unsigned frame = GetSubsystem<Time>()->GetFrameNumber();
+
+	if (frame != lastFrame_)
+	{
+		if (CacheStillValid())
+			lastFrame_ = frame;
+		else
+			Refresh();
+	}
+
+	if (hitPiece_.Expired())
+		return nullptr;
+
+	worldPos = hitPiece_->GetNode()->LocalToWorld(hitPosLocal_);
+	return hitPiece_;
+}
+
+const ea::vector<RayQueryResult>& PieceAimQuery::GetResults()
+{
+	//the result list holds raw drawable pointers so it is only reused within the frame it was cast in.
+	if (resultsFrame_ != GetSubsystem<Time>()->GetFrameNumber())
+		Refresh();
+
+	return results_;
+}
+
+void PieceAimQuery::Refresh()
+{
+	lastFrame_ = GetSubsystem<Time>()->GetFrameNumber();
+	resultsFrame_ = lastFrame_;
+	lastLookTransform_ = node_->GetWorldTransform();
+	hasCache_ = true;
+
+	hitPiece_ = nullptr;
+	results_.clear();
+
+	Octree* octree = GetScene()->GetComponent<Octree>();
+	if (!octree)
+		return;
+
+	Ray ray(node_->GetWorldPosition(), node_->GetWorldDirection());
+	RayOctreeQuery query(ray, RAY_TRIANGLE, M_INFINITY, DRAWABLE_GEOMETRY, PIECE_VIEWMASK_PICKABLE);
+
+	GetSubsystem<VisualDebugger>()->AddLine(node_->GetWorldPosition(), node_->GetWorldPosition() + node_->GetWorldDirection() * 10.0f, Color::GREEN, false);
+
+	octree->Raycast(query);
+	results_ = query.result_;
+
+	//the first pickable hit wins.  if it is not a piece the view to any piece is blocked.
+	if (results_.size())
+	{
+		Node* hitNode = results_.front().node_;
+		Piece* piece = hitNode->GetParent() ? hitNode->GetParent()->GetComponent<Piece>() : nullptr;
+		if (piece)
+		{
+			hitPiece_ = piece;
+			hitPosLocal_ = piece->GetNode()->WorldToLocal(results_.front().position_);
+			lastHitTransform_ = piece->GetNode()->GetWorldTransform();
+		}
+	}
+}
+
+bool PieceAimQuery::CacheStillValid()
+{
+	//misses are never reused - something could have moved into view.
+	if (!hasCache_ || hitPiece_.Expired())
+		return false;
+
+	if (!node_->GetWorldTransform().Equals(lastLookTransform_))
+		return false;
+
+	if (!hitPiece_->GetNode()->GetWorldTransform().Equals(lastHitTransform_))
+		return false;
+
+	return true;
+}
+
+void PieceAimQuery::HandleNodeRemoved(StringHash event, VariantMap& eventData)
+{
+	//any removal could leave raw pointers in results_ dangling - drop the cache.
+	Invalidate();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+//view mask bit tested by aim raycasts.  helper visuals (gather node, point indicators) clear this bit so they never block piece picking.
+#define PIECE_VIEWMASK_PICKABLE (1 << 1)
+
+
+class Piece;
+
+//component placed on a look node (camera/head or vr hand) that answers "which piece is being aimed at".
+//the octree is raycast at most once per frame and the hit is reused across frames while the look node and the hit piece have not moved.
+class PieceAimQuery : public Component
+{
+	URHO3D_OBJECT(PieceAimQuery, Component);
+
+public:
+
+	PieceAimQuery(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	///returns the closest aimed at piece (or nullptr) and the world hit position on it.
+	Piece* GetAimPiece(Vector3& worldPos);
+
+	///returns all pickable ray hits for the current frame sorted by distance.
+	const ea::vector<RayQueryResult>& GetResults();
+
+	///forces the next query to raycast again.
+	void Invalidate() { lastFrame_ = M_MAX_UNSIGNED; resultsFrame_ = M_MAX_UNSIGNED; hasCache_ = false; }
+
+protected:
+
+	void Refresh();
+
+	bool CacheStillValid();
+
+	void HandleNodeRemoved(StringHash event, VariantMap& eventData);
+
+	ea::vector<RayQueryResult> results_;
+
+	WeakPtr<Piece> hitPiece_;
+	Vector3 hitPosLocal_;//hit position in the space of the hit piece's node.
+
+	Matrix3x4 lastLookTransform_;
+	Matrix3x4 lastHitTransform_;
+
+	unsigned lastFrame_ = M_MAX_UNSIGNED;
+	unsigned resultsFrame_ = M_MAX_UNSIGNED;
+	bool hasCache_ = false;
+};
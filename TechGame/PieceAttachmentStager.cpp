@@ -6,6 +6,7 @@
 #include "PiecePoint.h"
 #include "PiecePointRow.h"
 #include "PieceManager.h"
+#include "PieceUndoJournal.h"
 
 #include "NewtonPhysicsWorld.h"
 
@@ -247,6 +248,13 @@ bool PieceAttachmentStager::AttachAll()
 			allPieces.push_back(pair->pieceB);
 	}
 
+	PieceManager* pieceManager = scene_->GetComponent<PieceManager>();
+	for (Piece* pc : allPieces)
+		pieceManager->WakeContraption(pc);
+
+	PieceUndoJournal* journal = pieceManager->GetUndoJournal();
+	journal->BeginOperation("Attach", allPieces);
+
 	//un solidifying pieces involved in attachment
 	ea::vector<PieceSolidificationGroup*> allGroups;
 	for (Piece* pc : allPieces) {
@@ -285,7 +293,7 @@ bool PieceAttachmentStager::AttachAll()
 	scene_->GetComponent<PieceManager>()->CleanAll();
 	scene_->GetComponent<PieceManager>()->RebuildSolidifies();
 
-
+	journal->EndOperation();
 
 	return allAttachSuccess;
 }
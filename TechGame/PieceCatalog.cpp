@@ -0,0 +1,377 @@
+#include "PieceCatalog.h"
+#include "PieceManager.h"
+#include "Piece.h"
+#include "PiecePoint.h"
+#include "PiecePointRow.h"
+#include "PieceGear.h"
+
+#include "NewtonPhysicsWorld.h"
+#include "NewtonRigidBody.h"
+#include "NewtonCollisionShapesDerived.h"
+
+
+
+void PieceCatalogEntry::Write(Serializer& dest) const
+{
+	dest.WriteString(name_);
+	dest.WriteString(modelName_);
+	dest.WriteVector3(visualScale_);
+	dest.WriteUInt(palletId_);
+	dest.WriteFloat(massScale_);
+
+	dest.WriteVLE(shapes_.size());
+	for (const Shape& shape : shapes_)
+	{
+		dest.WriteUByte(shape.type_);
+		dest.WriteVector3(shape.scaleFactor_);
+		dest.WriteVector3(shape.positionOffset_);
+		dest.WriteQuaternion(shape.rotationOffset_);
+		dest.WriteFloat(shape.radius_);
+		dest.WriteFloat(shape.length_);
+	}
+
+	dest.WriteVLE(points_.size());
+	for (const Point& point : points_)
+	{
+		dest.WriteVector3(point.position_);
+		dest.WriteQuaternion(point.rotation_);
+		dest.WriteVector3(point.direction_);
+		dest.WriteBool(point.isEndCap_);
+	}
+
+	dest.WriteVLE(rows_.size());
+	for (const Row& row : rows_)
+	{
+		dest.WriteInt(row.rowType_);
+		dest.WriteVector3(row.localDirection_);
+		dest.WriteBool(row.piecePlaner_);
+		dest.WriteVLE(row.points_.size());
+		for (unsigned index : row.points_)
+			dest.WriteVLE(index);
+	}
+
+	dest.WriteVLE(gears_.size());
+	for (const Gear& gear : gears_)
+	{
+		dest.WriteFloat(gear.radius_);
+		dest.WriteVector3(gear.normal_);
+	}
+}
+
+//every count is bounded by the bytes left so a corrupt entry cannot request huge allocations.
+static bool ReadCount(Deserializer& source, unsigned& count)
+{
+	count = source.ReadVLE();
+	return count <= source.GetSize() - source.GetPosition();
+}
+
+bool PieceCatalogEntry::Read(Deserializer& source)
+{
+	name_ = source.ReadString();
+	modelName_ = source.ReadString();
+	visualScale_ = source.ReadVector3();
+	palletId_ = source.ReadUInt();
+	massScale_ = source.ReadFloat();
+
+	unsigned count;
+	if (!ReadCount(source, count))
+		return false;
+	shapes_.resize(count);
+	for (Shape& shape : shapes_)
+	{
+		shape.type_ = ShapeType(source.ReadUByte());
+		shape.scaleFactor_ = source.ReadVector3();
+		shape.positionOffset_ = source.ReadVector3();
+		shape.rotationOffset_ = source.ReadQuaternion();
+		shape.radius_ = source.ReadFloat();
+		shape.length_ = source.ReadFloat();
+	}
+
+	if (!ReadCount(source, count))
+		return false;
+	points_.resize(count);
+	for (Point& point : points_)
+	{
+		point.position_ = source.ReadVector3();
+		point.rotation_ = source.ReadQuaternion();
+		point.direction_ = source.ReadVector3();
+		point.isEndCap_ = source.ReadBool();
+	}
+
+	if (!ReadCount(source, count))
+		return false;
+	rows_.resize(count);
+	for (Row& row : rows_)
+	{
+		row.rowType_ = source.ReadInt();
+		row.localDirection_ = source.ReadVector3();
+		row.piecePlaner_ = source.ReadBool();
+		unsigned numPoints;
+		if (!ReadCount(source, numPoints))
+			return false;
+		row.points_.resize(numPoints);
+		for (unsigned& index : row.points_)
+		{
+			index = source.ReadVLE();
+			if (index >= points_.size())
+				return false;
+		}
+	}
+
+	if (!ReadCount(source, count))
+		return false;
+	gears_.resize(count);
+	for (Gear& gear : gears_)
+	{
+		gear.radius_ = source.ReadFloat();
+		gear.normal_ = source.ReadVector3();
+	}
+
+	return true;
+}
+
+
+
+PieceCatalog::PieceCatalog(Context* context) : Object(context)
+{
+}
+
+PieceCatalog::~PieceCatalog()
+{
+	Unload();
+}
+
+bool PieceCatalog::Load(const ea::string& fileName)
+{
+	Unload();
+
+	if (fileName.empty() || !file_.Open(fileName))
+		return false;
+
+	MemoryBuffer header(file_.GetData(), file_.GetSize());
+	if (header.ReadFileID() != "PCAT" || header.ReadUInt() != PIECECATALOG_VERSION)
+	{
+		URHO3D_LOGWARNING("PieceCatalog: " + fileName + " is not a catalog of the current version - rebuild with -BuildPieceCatalog");
+		Unload();
+		return false;
+	}
+
+	if (header.ReadString() != PIECE_DEFINITION_HASH)
+	{
+		URHO3D_LOGWARNING("PieceCatalog: " + fileName + " was built from other piece definitions - creating pieces procedurally.  rebuild with -BuildPieceCatalog");
+		Unload();
+		return false;
+	}
+
+	scaleFactor_ = header.ReadFloat();
+	unsigned count = header.ReadUInt();
+	for (unsigned i = 0; i < count; i++)
+	{
+		StringHash nameHash(header.ReadUInt());
+		IndexEntry indexEntry;
+		indexEntry.offset_ = header.ReadUInt();
+		indexEntry.size_ = header.ReadUInt();
+
+		if (header.IsEof() || indexEntry.offset_ > file_.GetSize() || indexEntry.size_ > file_.GetSize() - indexEntry.offset_)
+		{
+			URHO3D_LOGWARNING("PieceCatalog: " + fileName + " is truncated");
+			Unload();
+			return false;
+		}
+
+		index_.insert_or_assign(nameHash, indexEntry);
+	}
+
+	URHO3D_LOGINFO("PieceCatalog: mapped " + ea::to_string(count) + " piece types from " + fileName);
+	return true;
+}
+
+void PieceCatalog::Unload()
+{
+	entries_.clear();
+	index_.clear();
+	file_.Close();
+}
+
+const PieceCatalogEntry* PieceCatalog::GetEntry(const ea::string& name)
+{
+	StringHash nameHash(name);
+
+	auto decoded = entries_.find(nameHash);
+	if (decoded != entries_.end())
+		return &decoded->second;
+
+	auto it = index_.find(nameHash);
+	if (it == index_.end())
+		return nullptr;
+
+	MemoryBuffer blob(file_.GetData() + it->second.offset_, it->second.size_);
+	PieceCatalogEntry entry;
+	if (!entry.Read(blob) || entry.name_ != name)
+	{
+		URHO3D_LOGWARNING("PieceCatalog: bad entry for " + name);
+		index_.erase(it);
+		return nullptr;
+	}
+
+	return &entries_.insert_or_assign(nameHash, entry).first->second;
+}
+
+bool PieceCatalog::Build(Context* context, const ea::string& fileName)
+{
+	//scratch scene - the procedural code expects a PieceManager and a physics world to build into.
+	SharedPtr<Scene> scene(new Scene(context));
+	scene->CreateComponent<Octree>();
+	scene->CreateComponent<NewtonPhysicsWorld>();
+	PieceManager* pieceManager = scene->CreateComponent<PieceManager>();
+	pieceManager->SetUsePieceCatalog(false);
+
+	ea::vector<ea::string> names;
+	PieceManager::GetProceduralPieceNames(names);
+
+	ea::vector<StringHash> hashes;
+	ea::vector<VectorBuffer> blobs;
+	for (const ea::string& name : names)
+	{
+		Node* root = pieceManager->CreatePiece(name, false);
+
+		PieceCatalogEntry entry;
+		if (CaptureEntry(root, entry))
+		{
+			VectorBuffer blob;
+			entry.Write(blob);
+			hashes.push_back(StringHash(name));
+			blobs.push_back(blob);
+		}
+		else
+		{
+			URHO3D_LOGWARNING("PieceCatalog: " + name + " cannot be described by the catalog and will stay procedural.");
+		}
+
+		root->Remove();
+	}
+
+	File file(context, fileName, FILE_WRITE);
+	if (!file.IsOpen())
+	{
+		URHO3D_LOGERROR("PieceCatalog: could not open " + fileName + " for writing");
+		return false;
+	}
+
+	const ea::string definitionHash = PIECE_DEFINITION_HASH;
+	unsigned headerSize = 4 + 4 + (definitionHash.length() + 1) + 4 + 4 + blobs.size() * 12;
+
+	file.WriteFileID("PCAT");
+	file.WriteUInt(PIECECATALOG_VERSION);
+	file.WriteString(definitionHash);
+	file.WriteFloat(pieceManager->GetScaleFactor());
+	file.WriteUInt(blobs.size());
+
+	unsigned offset = headerSize;
+	for (unsigned i = 0; i < blobs.size(); i++)
+	{
+		file.WriteUInt(hashes[i].Value());
+		file.WriteUInt(offset);
+		file.WriteUInt(blobs[i].GetSize());
+		offset += blobs[i].GetSize();
+	}
+
+	for (const VectorBuffer& blob : blobs)
+		file.Write(blob.GetData(), blob.GetSize());
+
+	URHO3D_LOGINFO("PieceCatalog: wrote " + ea::to_string(blobs.size()) + " piece types to " + fileName);
+	return true;
+}
+
+bool PieceCatalog::CaptureEntry(Node* root, PieceCatalogEntry& entry)
+{
+	Node* visualNode = root->GetChild("visualNode");
+	StaticModel* staticModel = visualNode ? visualNode->GetComponent<StaticModel>() : nullptr;
+	NewtonRigidBody* body = root->GetComponent<NewtonRigidBody>();
+	Piece* piece = root->GetComponent<Piece>();
+	if (!staticModel || !staticModel->GetModel() || !body || !piece)
+		return false;
+
+	entry.name_ = root->GetVar("PieceName").GetString();
+	entry.modelName_ = staticModel->GetModel()->GetName();
+	entry.visualScale_ = visualNode->GetScale();
+	entry.palletId_ = piece->GetColorPalletId().Value();
+	entry.massScale_ = body->GetMassScale();
+
+	//points - every other child must be a plain point node.
+	ea::hash_map<PiecePoint*, unsigned> pointIndices;
+	for (Node* child : root->GetChildren())
+	{
+		if (child == visualNode)
+			continue;
+
+		PiecePoint* point = child->GetComponent<PiecePoint>();
+		if (!point || child->GetNumComponents() != 1 || child->GetNumChildren())
+			return false;
+
+		PieceCatalogEntry::Point catalogPoint;
+		catalogPoint.position_ = child->GetPosition();
+		catalogPoint.rotation_ = child->GetRotation();
+		catalogPoint.direction_ = point->direction_;
+		catalogPoint.isEndCap_ = point->isEndCap_;
+
+		pointIndices.insert_or_assign(point, entry.points_.size());
+		entry.points_.push_back(catalogPoint);
+	}
+
+	for (Component* component : root->GetComponents())
+	{
+		if (component == body || component == piece)
+			continue;
+
+		if (NewtonCollisionShape_Box* box = dynamic_cast<NewtonCollisionShape_Box*>(component))
+		{
+			PieceCatalogEntry::Shape shape;
+			shape.type_ = PieceCatalogEntry::ShapeType_Box;
+			shape.scaleFactor_ = box->GetScaleFactor();
+			shape.positionOffset_ = box->GetPositionOffset();
+			shape.rotationOffset_ = box->GetRotationOffset();
+			entry.shapes_.push_back(shape);
+		}
+		else if (NewtonCollisionShape_Cylinder* cylinder = dynamic_cast<NewtonCollisionShape_Cylinder*>(component))
+		{
+			PieceCatalogEntry::Shape shape;
+			shape.type_ = PieceCatalogEntry::ShapeType_Cylinder;
+			shape.scaleFactor_ = cylinder->GetScaleFactor();
+			shape.positionOffset_ = cylinder->GetPositionOffset();
+			shape.rotationOffset_ = cylinder->GetRotationOffset();
+			shape.radius_ = cylinder->GetRadius();
+			shape.length_ = cylinder->GetLength();
+			entry.shapes_.push_back(shape);
+		}
+		else if (PiecePointRow* row = dynamic_cast<PiecePointRow*>(component))
+		{
+			PieceCatalogEntry::Row catalogRow;
+			catalogRow.rowType_ = row->GetRowType();
+			catalogRow.localDirection_ = row->GetAttribute("localDirection").GetVector3();
+			catalogRow.piecePlaner_ = row->GetIsPiecePlaner();
+
+			for (PiecePoint* point : row->GetPoints())
+			{
+				auto it = pointIndices.find(point);
+				if (it == pointIndices.end())
+					return false;
+				catalogRow.points_.push_back(it->second);
+			}
+			entry.rows_.push_back(catalogRow);
+		}
+		else if (PieceGear* gear = dynamic_cast<PieceGear*>(component))
+		{
+			PieceCatalogEntry::Gear catalogGear;
+			catalogGear.radius_ = gear->GetRadius();
+			catalogGear.normal_ = gear->GetNormal();
+			entry.gears_.push_back(catalogGear);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
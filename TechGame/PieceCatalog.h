@@ -0,0 +1,113 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+#include "MappedFile.h"
+
+
+#define PIECECATALOG_FILENAME "PieceCatalog.bin"
+#define PIECECATALOG_VERSION 2
+
+//hash of the procedural piece definitions (PieceCreation.cpp), set by CMake.  a catalog built from other definitions is not used.
+#ifndef PIECE_DEFINITION_HASH
+#define PIECE_DEFINITION_HASH ""
+#endif
+
+
+//precomputed description of one piece type.  lengths already include the scale factor the catalog was built with.
+struct PieceCatalogEntry
+{
+	enum ShapeType {
+		ShapeType_Box = 0,
+		ShapeType_Cylinder
+	};
+
+	struct Shape {
+		ShapeType type_ = ShapeType_Box;
+		Vector3 scaleFactor_ = Vector3::ONE;
+		Vector3 positionOffset_;
+		Quaternion rotationOffset_;
+		float radius_ = 0.0f;
+		float length_ = 0.0f;
+	};
+
+	struct Point {
+		Vector3 position_;
+		Quaternion rotation_;
+		Vector3 direction_ = Vector3::FORWARD;
+		bool isEndCap_ = false;
+	};
+
+	struct Row {
+		int rowType_ = 0;
+		Vector3 localDirection_;
+		bool piecePlaner_ = false;
+		ea::vector<unsigned> points_;//indexes into points_ of the entry
+	};
+
+	struct Gear {
+		float radius_ = 1.0f;
+		Vector3 normal_ = Vector3::FORWARD;
+	};
+
+	ea::string name_;
+	ea::string modelName_;
+	Vector3 visualScale_ = Vector3::ONE;
+	unsigned palletId_ = 0;
+	float massScale_ = 1.0f;
+
+	ea::vector<Shape> shapes_;
+	ea::vector<Point> points_;
+	ea::vector<Row> rows_;
+	ea::vector<Gear> gears_;
+
+	void Write(Serializer& dest) const;
+	bool Read(Deserializer& source);
+};
+
+
+//binary catalog of piece types.  built offline from the procedural CreatePiece code (-BuildPieceCatalog) and memory mapped at runtime.
+//the file is a header with a name-hash index followed by the entry blobs.  entries are decoded lazily on first lookup.
+class PieceCatalog : public Object
+{
+	URHO3D_OBJECT(PieceCatalog, Object);
+
+public:
+
+	PieceCatalog(Context* context);
+	virtual ~PieceCatalog();
+
+	///map the catalog file.  returns false and leaves the catalog empty if the file is missing, from another version or built from other
+	///piece definitions - pieces are then created procedurally.
+	bool Load(const ea::string& fileName);
+
+	void Unload();
+
+	bool IsLoaded() const { return file_.IsOpen(); }
+
+	///returns the entry for the given piece name or nullptr if the catalog does not have it.
+	const PieceCatalogEntry* GetEntry(const ea::string& name);
+
+	///scale factor the catalog was built with.  entries must not be used by a PieceManager with a different scale.
+	float GetScaleFactor() const { return scaleFactor_; }
+
+	unsigned GetNumEntries() const { return index_.size(); }
+
+	///offline build step: spawns every procedural piece type into a scratch scene and writes their descriptions to fileName.
+	static bool Build(Context* context, const ea::string& fileName);
+
+	///describe a procedurally built piece.  returns false if the piece has anything the catalog cannot reproduce.
+	static bool CaptureEntry(Node* root, PieceCatalogEntry& entry);
+
+protected:
+
+	struct IndexEntry {
+		unsigned offset_ = 0;
+		unsigned size_ = 0;
+	};
+
+	MappedFile file_;
+
+	float scaleFactor_ = 1.0f;
+
+	ea::hash_map<StringHash, IndexEntry> index_;
+	ea::hash_map<StringHash, PieceCatalogEntry> entries_;
+};
@@ -0,0 +1,647 @@
+#include "PieceContraptionFile.h"
+#include "PieceUndoJournal.h"
+#include "PieceManager.h"
+#include "Piece.h"
+#include "PiecePoint.h"
+#include "PiecePointRow.h"
+#include "PieceSolidificationGroup.h"
+#include "MappedFile.h"
+
+#include "NewtonRigidBody.h"
+
+
+//binary contraption layout (all counts and indexes are VLE):
+//  "MCON" version
+//  type names                      - pieces and assemblies refer to these by index
+//  assemblies { type }             - each spawns once with CreatePieceAssembly
+//  groups { parent+1, pos, rot, solid }   - parents always come before children
+//  pieces { type, assembly+1, group+1, pos, rot, flags, color, massScale, welded point indexes }
+//  attachments { pieceA, rowA, pointA, pieceB, rowB, pointB }   - rows by index in Piece::GetPointRows, points by index in the row
+
+
+
+static unsigned GetGroupDepth(PieceSolidificationGroup* group)
+{
+	unsigned depth = 0;
+	Node* node = group->GetNode()->GetParent();
+	while (node)
+	{
+		if (node->GetComponent<PieceSolidificationGroup>())
+			depth++;
+		node = node->GetParent();
+	}
+	return depth;
+}
+
+//first group at or above node, looking through contraption LOD wrappers (they are not saved).
+static PieceSolidificationGroup* GetSavedGroup(Node* node)
+{
+	while (node)
+	{
+		PieceSolidificationGroup* group = node->GetComponent<PieceSolidificationGroup>();
+		if (group && !group->IsLodGroup())
+			return group;
+		if (!group)
+			return nullptr;
+		node = node->GetParent();
+	}
+	return nullptr;
+}
+
+void PieceManager::CaptureContraption(ContraptionFileData& data)
+{
+	CaptureContraption(data, pieceRegistry_.GetAll(), true);
+}
+
+void PieceManager::CaptureContraption(ContraptionFileData& data, const ea::vector<Piece*>& pieces, bool withGroups)
+{
+	data = ContraptionFileData();
+
+	//groups sorted so parents are written first.
+	ea::vector<ea::pair<unsigned, PieceSolidificationGroup*>> sortedGroups;
+	if (withGroups)
+	{
+		for (PieceSolidificationGroup* group : groupRegistry_.GetAll())
+		{
+			if (!group->IsLodGroup())
+				sortedGroups.push_back({ GetGroupDepth(group), group });
+		}
+	}
+	ea::stable_sort(sortedGroups.begin(), sortedGroups.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	ea::hash_map<PieceSolidificationGroup*, unsigned> groupIndexes;
+	for (unsigned i = 0; i < sortedGroups.size(); i++)
+		groupIndexes.insert_or_assign(sortedGroups[i].second, i);
+
+
+	ea::hash_map<ea::string, unsigned> typeIndexes;
+	auto getTypeIndex = [&](const ea::string& name) {
+		auto it = typeIndexes.find(name);
+		if (it != typeIndexes.end())
+			return it->second;
+		unsigned index = data.typeNames_.size();
+		data.typeNames_.push_back(name);
+		typeIndexes.insert_or_assign(name, index);
+		return index;
+	};
+
+	//assembly instances - one per set of linked pieces.
+	ea::hash_map<Piece*, unsigned> pieceAssemblies;
+	for (Piece* piece : pieces)
+	{
+		ea::string assemblyName = piece->GetNode()->GetVar("AssemblyName").ToString();
+		if (assemblyName.empty() || pieceAssemblies.contains(piece))
+			continue;
+
+		ea::vector<Piece*> assemblyPieces;
+		piece->GetAssemblyPieces(assemblyPieces, true);
+		for (Piece* member : assemblyPieces)
+			pieceAssemblies.insert_or_assign(member, data.assemblies_.size());
+
+		data.assemblies_.push_back(getTypeIndex(assemblyName));
+	}
+
+	ea::hash_map<Piece*, unsigned> pieceIndexes;
+	ea::hash_map<PiecePointRow*, unsigned> rowIndexes;
+	for (unsigned i = 0; i < pieces.size(); i++)
+	{
+		pieceIndexes.insert_or_assign(pieces[i], i);
+
+		ea::vector<PiecePointRow*> rows;
+		pieces[i]->GetPointRows(rows);
+		for (unsigned r = 0; r < rows.size(); r++)
+			rowIndexes.insert_or_assign(rows[r], r);
+	}
+
+
+	data.groups_.resize(sortedGroups.size());
+	for (unsigned i = 0; i < sortedGroups.size(); i++)
+	{
+		PieceSolidificationGroup* group = sortedGroups[i].second;
+		PieceSolidificationGroup* parentGroup = GetSavedGroup(group->GetNode()->GetParent());
+
+		ContraptionFileData::Group& record = data.groups_[i];
+		record.parent_ = parentGroup ? groupIndexes[parentGroup] + 1 : 0;
+		record.position_ = group->GetNode()->GetWorldPosition();
+		record.rotation_ = group->GetNode()->GetWorldRotation();
+		record.solid_ = group->GetSolidified();
+	}
+
+	data.pieces_.resize(pieces.size());
+	for (unsigned i = 0; i < pieces.size(); i++)
+	{
+		Piece* piece = pieces[i];
+		Node* node = piece->GetNode();
+		PieceSolidificationGroup* group = withGroups ? GetSavedGroup(node->GetParent()) : nullptr;
+		auto assembly = pieceAssemblies.find(piece);
+
+		ContraptionFileData::PieceRecord& record = data.pieces_[i];
+		record.type_ = getTypeIndex(node->GetVar("PieceName").ToString());
+		record.assembly_ = assembly != pieceAssemblies.end() ? assembly->second + 1 : 0;
+		record.group_ = group ? groupIndexes[group] + 1 : 0;
+		record.position_ = node->GetWorldPosition();
+		record.rotation_ = node->GetWorldRotation();
+
+		if (piece->GetUseColorPallet())
+			record.flags_ |= ContraptionPiece_UseColorPallet;
+		if (piece->IsOiled())
+			record.flags_ |= ContraptionPiece_Oiled;
+		if (piece->GetEnableDynamicDetachment())
+			record.flags_ |= ContraptionPiece_DynamicDetach;
+
+		record.palletId_ = piece->GetColorPalletId().Value();
+		record.color_ = piece->GetPrimaryColor();
+
+		NewtonRigidBody* body = node->GetComponent<NewtonRigidBody>();
+		record.massScale_ = body ? body->GetMassScale() : 1.0f;
+
+		ea::vector<PiecePoint*> points;
+		piece->GetPoints(points);
+		for (unsigned p = 0; p < points.size(); p++)
+		{
+			if (points[p]->IsWelded())
+				record.weldedPoints_.push_back(p);
+		}
+	}
+
+
+	//each attachment is stored by both rows - keep it once from the lower piece/row.
+	for (Piece* piece : pieces)
+	{
+		ea::vector<PiecePointRow*> rows;
+		piece->GetPointRows(rows);
+		for (PiecePointRow* row : rows)
+		{
+			for (const PiecePointRow::RowAttachement& attachment : row->rowAttachements_)
+			{
+				PiecePointRow* otherRow = attachment.rowOther_;
+				if (!otherRow || !attachment.point || !attachment.pointOther_)
+					continue;
+
+				auto otherPiece = pieceIndexes.find(otherRow->GetPiece());
+				if (otherPiece == pieceIndexes.end())
+					continue;
+
+				if (row->GetPointIndex(attachment.point) == M_MAX_UNSIGNED || otherRow->GetPointIndex(attachment.pointOther_) == M_MAX_UNSIGNED)
+					continue;
+
+				unsigned pieceIndex = pieceIndexes[piece];
+				unsigned rowIndex = rowIndexes[row];
+				unsigned otherRowIndex = rowIndexes[otherRow];
+				if (otherPiece->second < pieceIndex || (otherPiece->second == pieceIndex && otherRowIndex < rowIndex))
+					continue;
+
+				ContraptionFileData::Attachment record;
+				record.piece_[0] = pieceIndex;
+				record.row_[0] = rowIndex;
+				record.point_[0] = row->GetPointIndex(attachment.point);
+				record.piece_[1] = otherPiece->second;
+				record.row_[1] = otherRowIndex;
+				record.point_[1] = otherRow->GetPointIndex(attachment.pointOther_);
+				data.attachments_.push_back(record);
+			}
+		}
+	}
+}
+
+bool PieceManager::SaveContraption(Serializer& dest)
+{
+	ContraptionFileData data;
+	CaptureContraption(data);
+	return data.Write(dest);
+}
+
+bool PieceManager::SaveContraptionFile(const ea::string& fileName)
+{
+	VectorBuffer buffer;
+	if (!SaveContraption(buffer))
+		return false;
+
+	File file(context_, fileName, FILE_WRITE);
+	if (!file.IsOpen())
+		return false;
+
+	return file.Write(buffer.GetData(), buffer.GetSize()) == buffer.GetSize();
+}
+
+bool ContraptionFileData::Write(Serializer& dest) const
+{
+	bool success = dest.WriteFileID(CONTRAPTION_FILEID);
+	success &= dest.WriteUInt(CONTRAPTION_VERSION);
+
+	success &= dest.WriteVLE(typeNames_.size());
+	for (const ea::string& name : typeNames_)
+		success &= dest.WriteString(name);
+
+	success &= dest.WriteVLE(assemblies_.size());
+	for (unsigned type : assemblies_)
+		success &= dest.WriteVLE(type);
+
+	success &= dest.WriteVLE(groups_.size());
+	for (const Group& group : groups_)
+	{
+		success &= dest.WriteVLE(group.parent_);
+		success &= dest.WriteVector3(group.position_);
+		success &= dest.WriteQuaternion(group.rotation_);
+		success &= dest.WriteBool(group.solid_);
+	}
+
+	success &= dest.WriteVLE(pieces_.size());
+	for (const PieceRecord& record : pieces_)
+	{
+		success &= dest.WriteVLE(record.type_);
+		success &= dest.WriteVLE(record.assembly_);
+		success &= dest.WriteVLE(record.group_);
+		success &= dest.WriteVector3(record.position_);
+		success &= dest.WriteQuaternion(record.rotation_);
+		success &= dest.WriteUByte(record.flags_);
+
+		if (record.flags_ & ContraptionPiece_UseColorPallet)
+			success &= dest.WriteUInt(record.palletId_);
+		else
+			success &= dest.WriteColor(record.color_);
+
+		success &= dest.WriteFloat(record.massScale_);
+
+		success &= dest.WriteVLE(record.weldedPoints_.size());
+		for (unsigned p : record.weldedPoints_)
+			success &= dest.WriteVLE(p);
+	}
+
+	success &= dest.WriteVLE(attachments_.size());
+	for (const Attachment& attachment : attachments_)
+	{
+		for (unsigned s = 0; s < 2; s++)
+		{
+			success &= dest.WriteVLE(attachment.piece_[s]);
+			success &= dest.WriteVLE(attachment.row_[s]);
+			success &= dest.WriteVLE(attachment.point_[s]);
+		}
+	}
+
+	return success;
+}
+
+bool ContraptionFileData::WriteCompressed(Serializer& dest) const
+{
+	VectorBuffer raw;
+	if (!Write(raw))
+		return false;
+
+	raw.Seek(0);
+	return dest.WriteFileID(CONTRAPTION_COMPRESSED_FILEID) && CompressStream(dest, raw);
+}
+
+bool ContraptionFileData::Read(Deserializer& source)
+{
+	ea::string fileId = source.ReadFileID();
+	if (fileId == CONTRAPTION_COMPRESSED_FILEID)
+	{
+		VectorBuffer raw;
+		if (!DecompressStream(raw, source))
+			return false;
+
+		raw.Seek(0);
+		return Read(raw);
+	}
+
+	if (fileId != CONTRAPTION_FILEID)
+	{
+		URHO3D_LOGWARNING("LoadContraption: not a contraption file");
+		return false;
+	}
+
+	unsigned version = source.ReadUInt();
+	if (version != CONTRAPTION_VERSION)
+	{
+		URHO3D_LOGWARNING("LoadContraption: unsupported version " + ea::to_string(version));
+		return false;
+	}
+
+	//every count is bounded by the bytes left so a corrupt file cannot request huge allocations.
+	auto readCount = [&source]() {
+		unsigned count = source.ReadVLE();
+		return count <= source.GetSize() - source.GetPosition() ? count : 0u;
+	};
+
+	typeNames_.resize(readCount());
+	for (ea::string& name : typeNames_)
+		name = source.ReadString();
+
+	assemblies_.resize(readCount());
+	for (unsigned& type : assemblies_)
+	{
+		type = source.ReadVLE();
+		if (type >= typeNames_.size())
+			return false;
+	}
+
+	groups_.resize(readCount());
+	for (unsigned i = 0; i < groups_.size(); i++)
+	{
+		Group& group = groups_[i];
+		group.parent_ = source.ReadVLE();
+		group.position_ = source.ReadVector3();
+		group.rotation_ = source.ReadQuaternion();
+		group.solid_ = source.ReadBool();
+
+		if (group.parent_ > i)
+			return false;
+	}
+
+	pieces_.resize(readCount());
+	for (PieceRecord& record : pieces_)
+	{
+		record.type_ = source.ReadVLE();
+		record.assembly_ = source.ReadVLE();
+		record.group_ = source.ReadVLE();
+		record.position_ = source.ReadVector3();
+		record.rotation_ = source.ReadQuaternion();
+		record.flags_ = source.ReadUByte();
+
+		if (record.flags_ & ContraptionPiece_UseColorPallet)
+			record.palletId_ = source.ReadUInt();
+		else
+			record.color_ = source.ReadColor();
+
+		record.massScale_ = source.ReadFloat();
+
+		record.weldedPoints_.resize(readCount());
+		for (unsigned& p : record.weldedPoints_)
+			p = source.ReadVLE();
+
+		if (record.type_ >= typeNames_.size() || record.assembly_ > assemblies_.size() || record.group_ > groups_.size())
+			return false;
+	}
+
+	attachments_.resize(readCount());
+	for (Attachment& attachment : attachments_)
+	{
+		for (unsigned s = 0; s < 2; s++)
+		{
+			attachment.piece_[s] = source.ReadVLE();
+			attachment.row_[s] = source.ReadVLE();
+			attachment.point_[s] = source.ReadVLE();
+
+			if (attachment.piece_[s] >= pieces_.size())
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+ContraptionBuilder::ContraptionBuilder(PieceManager* manager, const ContraptionFileData* data) :
+	manager_(manager),
+	data_(data)
+{
+	pieces_.resize(data->pieces_.size());
+	assemblyMembers_.resize(data->assemblies_.size());
+	assemblySpawned_.resize(data->assemblies_.size(), false);
+	groupNodes_.resize(data->groups_.size());
+}
+
+bool ContraptionBuilder::SpawnPiece(unsigned index, bool freeze)
+{
+	const ContraptionFileData::PieceRecord& record = data_->pieces_[index];
+	const ea::string& typeName = data_->typeNames_[record.type_];
+
+	Node* node = nullptr;
+	if (record.assembly_)
+	{
+		unsigned assembly = record.assembly_ - 1;
+		if (!assemblySpawned_[assembly])
+		{
+			//spawn the whole assembly once and let its members be claimed by name.
+			assemblySpawned_[assembly] = true;
+
+			Node* assemblyRoot = manager_->CreatePieceAssembly(data_->typeNames_[data_->assemblies_[assembly]], false);
+			ea::vector<Node*> children;
+			manager_->UnPackAssembly(assemblyRoot, children);
+			assemblyRoot->Remove();
+
+			for (Node* child : children)
+			{
+				createdNodes_.push_back(WeakPtr<Node>(child));
+				assemblyMembers_[assembly].insert_or_assign(child->GetVar("PieceName").ToString(), WeakPtr<Node>(child));
+
+				NewtonRigidBody* body = child->GetComponent<NewtonRigidBody>();
+				if (freeze && body)
+					body->SetMassScale(0.0f);
+			}
+		}
+
+		auto member = assemblyMembers_[assembly].find(typeName);
+		if (member != assemblyMembers_[assembly].end())
+			node = member->second;
+	}
+	else
+	{
+		node = manager_->CreatePiece(typeName, false);
+		if (node)
+			createdNodes_.push_back(WeakPtr<Node>(node));
+	}
+
+	Piece* piece = node ? node->GetComponent<Piece>() : nullptr;
+	if (!piece)
+	{
+		URHO3D_LOGWARNING("LoadContraption: could not create piece " + typeName);
+		return false;
+	}
+	pieces_[index] = piece;
+
+	node->SetWorldPosition(record.position_);
+	node->SetWorldRotation(record.rotation_);
+
+	if (record.flags_ & ContraptionPiece_UseColorPallet)
+		piece->SetColorPalletId(StringHash(record.palletId_));
+	else
+		piece->SetPrimaryColor(record.color_);
+
+	piece->SetOiled(record.flags_ & ContraptionPiece_Oiled);
+	piece->SetEnableDynamicDetachmentAttrib(record.flags_ & ContraptionPiece_DynamicDetach);
+
+	if (NewtonRigidBody* body = node->GetComponent<NewtonRigidBody>())
+		body->SetMassScale(freeze ? 0.0f : record.massScale_);
+
+	return true;
+}
+
+bool ContraptionBuilder::Attach(unsigned index)
+{
+	const ContraptionFileData::Attachment& attachment = data_->attachments_[index];
+
+	PiecePointRow* rows[2] = { nullptr, nullptr };
+	PiecePoint* points[2] = { nullptr, nullptr };
+	for (unsigned s = 0; s < 2; s++)
+	{
+		Piece* piece = pieces_[attachment.piece_[s]];
+		if (!piece)
+			return false;
+
+		ea::vector<PiecePointRow*> pieceRows;
+		piece->GetPointRows(pieceRows);
+		if (attachment.row_[s] >= pieceRows.size() || attachment.point_[s] >= pieceRows[attachment.row_[s]]->GetPoints().size())
+			return false;
+
+		rows[s] = pieceRows[attachment.row_[s]];
+		points[s] = rows[s]->GetPoints()[attachment.point_[s]];
+	}
+
+	return PiecePointRow::AttachRows(rows[0], rows[1], points[0], points[1], false, true);
+}
+
+Node* ContraptionBuilder::GetGroupNode(unsigned index)
+{
+	if (groupNodes_[index])
+		return groupNodes_[index];
+
+	const ContraptionFileData::Group& record = data_->groups_[index];
+	Node* parent = record.parent_ ? GetGroupNode(record.parent_ - 1) : manager_->GetScene();
+
+	Node* groupNode = parent->CreateChild();
+	groupNode->SetWorldPosition(record.position_);
+	groupNode->SetWorldRotation(record.rotation_);
+	PieceSolidificationGroup* group = groupNode->CreateComponent<PieceSolidificationGroup>();
+	group->SetSolidStateAttrib(record.solid_);
+
+	groupNodes_[index] = groupNode;
+	createdNodes_.push_back(WeakPtr<Node>(groupNode));
+	return groupNode;
+}
+
+bool ContraptionBuilder::FinishPieces(const ea::vector<unsigned>& pieceIndexes)
+{
+	//callers rebuild the branches of these pieces once afterwards.
+	manager_->SuspendNodeRebuilds();
+
+	bool grouped = false;
+	for (unsigned index : pieceIndexes)
+	{
+		const ContraptionFileData::PieceRecord& record = data_->pieces_[index];
+		Piece* piece = pieces_[index];
+		if (!piece)
+			continue;
+
+		if (NewtonRigidBody* body = piece->GetNode()->GetComponent<NewtonRigidBody>())
+			body->SetMassScale(record.massScale_);
+
+		if (record.group_)
+		{
+			piece->GetNode()->SetParent(GetGroupNode(record.group_ - 1));
+			grouped = true;
+		}
+
+		ea::vector<PiecePoint*> points;
+		piece->GetPoints(points);
+		for (unsigned p : record.weldedPoints_)
+		{
+			if (p < points.size())
+				points[p]->SetWeldedAttrib(true);
+		}
+	}
+
+	manager_->ResumeNodeRebuilds();
+	return grouped;
+}
+
+void ContraptionBuilder::Abort()
+{
+	for (Node* node : createdNodes_)
+	{
+		if (node)
+			node->Remove();
+	}
+	createdNodes_.clear();
+}
+
+
+
+bool PieceManager::LoadContraption(Deserializer& source)
+{
+	ContraptionFileData data;
+	if (!data.Read(source))
+	{
+		URHO3D_LOGWARNING("LoadContraption: corrupt contraption data");
+		return false;
+	}
+
+	ContraptionBuilder builder(this, &data);
+	for (unsigned i = 0; i < data.pieces_.size(); i++)
+	{
+		if (!builder.SpawnPiece(i, false))
+		{
+			builder.Abort();
+			return false;
+		}
+	}
+
+	//attach while every piece is still ungrouped so each row pair sees its own bodies.
+	for (unsigned i = 0; i < data.attachments_.size(); i++)
+	{
+		if (!builder.Attach(i))
+			URHO3D_LOGWARNING("LoadContraption: could not restore attachment " + ea::to_string(i));
+	}
+
+	ea::vector<unsigned> allPieces(data.pieces_.size());
+	for (unsigned i = 0; i < allPieces.size(); i++)
+		allPieces[i] = i;
+	builder.FinishPieces(allPieces);
+
+	//only the loaded pieces' branches are new - the rest of the scene is untouched.
+	ea::vector<Node*> nodes;
+	for (unsigned i = 0; i < allPieces.size(); i++)
+	{
+		if (Piece* piece = builder.GetPiece(i))
+			nodes.push_back(piece->GetNode());
+	}
+	RebuildSolidifiesBranches(nodes);
+
+	URHO3D_LOGINFO("LoadContraption: loaded " + ea::to_string(data.pieces_.size()) + " pieces, " + ea::to_string(data.attachments_.size()) + " attachments");
+	return true;
+}
+
+bool PieceManager::LoadContraptionFile(const ea::string& fileName)
+{
+	MappedFile file;
+	if (!file.Open(fileName))
+	{
+		URHO3D_LOGWARNING("LoadContraptionFile: cannot open " + fileName);
+		return false;
+	}
+
+	MemoryBuffer buffer(file.GetData(), file.GetSize());
+	return LoadContraption(buffer);
+}
+
+void PieceManager::RemoveAllPieces()
+{
+	ea::vector<WeakPtr<Node>> nodes;
+	for (Piece* piece : pieceRegistry_.GetAll())
+		nodes.push_back(WeakPtr<Node>(piece->GetNode()));
+	for (PieceSolidificationGroup* group : groupRegistry_.GetAll())
+		nodes.push_back(WeakPtr<Node>(group->GetNode()));
+
+	ea::vector<Node*> assemblyRoots;
+	GetScene()->GetChildrenWithTag(assemblyRoots, "PieceAssembly", false);
+	for (Node* node : assemblyRoots)
+		nodes.push_back(WeakPtr<Node>(node));
+
+	for (Node* node : nodes)
+	{
+		if (node)
+			node->Remove();
+	}
+
+	lodContraptions_.clear();
+	lodIdleTimes_.clear();
+	scheduledContraptions_.clear();
+	scheduledBodies_.clear();
+	rateContactHolds_.clear();
+
+	//recorded deltas refer to pieces that are gone now.
+	if (!undoJournal_.Expired())
+		undoJournal_->Clear();
+}
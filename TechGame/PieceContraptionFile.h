@@ -0,0 +1,93 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+class PieceManager;
+class Piece;
+
+
+enum ContraptionPieceFlags {
+	ContraptionPiece_UseColorPallet = 1 << 0,
+	ContraptionPiece_Oiled = 1 << 1,
+	ContraptionPiece_DynamicDetach = 1 << 2
+};
+
+
+//decoded contents of a binary contraption file (written by PieceManager::SaveContraption).  Read() validates every index it can.
+struct ContraptionFileData
+{
+	struct Group {
+		unsigned parent_ = 0;//group index + 1, 0 = scene
+		Vector3 position_;
+		Quaternion rotation_;
+		bool solid_ = false;
+	};
+
+	struct PieceRecord {
+		unsigned type_ = 0;
+		unsigned assembly_ = 0;//assembly index + 1, 0 = none
+		unsigned group_ = 0;//group index + 1, 0 = none
+		Vector3 position_;
+		Quaternion rotation_;
+		unsigned char flags_ = 0;
+		unsigned palletId_ = 0;
+		Color color_;
+		float massScale_ = 1.0f;
+		ea::vector<unsigned> weldedPoints_;
+	};
+
+	struct Attachment {
+		unsigned piece_[2];
+		unsigned row_[2];
+		unsigned point_[2];
+	};
+
+	ea::vector<ea::string> typeNames_;
+	ea::vector<unsigned> assemblies_;
+	ea::vector<Group> groups_;
+	ea::vector<PieceRecord> pieces_;
+	ea::vector<Attachment> attachments_;
+
+	bool Write(Serializer& dest) const;
+
+	///lz4 compressed variant of Write.  Read() accepts both.
+	bool WriteCompressed(Serializer& dest) const;
+
+	bool Read(Deserializer& source);
+};
+
+
+//instantiates a ContraptionFileData step by step.  LoadContraption runs every step at once, ContraptionStreamLoader spreads them over frames.
+class ContraptionBuilder
+{
+public:
+
+	ContraptionBuilder(PieceManager* manager, const ContraptionFileData* data);
+
+	///spawn piece index (and its assembly the first time one of its members is needed).  frozen pieces are held static until FinishPieces.
+	bool SpawnPiece(unsigned index, bool freeze);
+
+	///attach the rows of attachment index.  both pieces must already be spawned and still ungrouped.
+	bool Attach(unsigned index);
+
+	///move the given pieces into their groups, restore welds and mass scales.  returns true if any piece was grouped (RebuildSolidifies needed).
+	bool FinishPieces(const ea::vector<unsigned>& pieceIndexes);
+
+	///remove everything spawned so far.
+	void Abort();
+
+	Piece* GetPiece(unsigned index) const { return pieces_[index]; }
+
+protected:
+
+	Node* GetGroupNode(unsigned index);
+
+	PieceManager* manager_;
+	const ContraptionFileData* data_;
+
+	ea::vector<WeakPtr<Piece>> pieces_;
+	ea::vector<ea::hash_map<ea::string, WeakPtr<Node>>> assemblyMembers_;
+	ea::vector<bool> assemblySpawned_;
+	ea::vector<WeakPtr<Node>> groupNodes_;
+	ea::vector<WeakPtr<Node>> createdNodes_;
+};
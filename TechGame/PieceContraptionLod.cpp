@@ -0,0 +1,244 @@
+#include "PieceManager.h"
+#include "Piece.h"
+#include "PieceSolidificationGroup.h"
+
+#include "NewtonRigidBody.h"
+
+
+
+//the LOD wrapper group above node, if any.
+static PieceSolidificationGroup* GetLodGroup(Node* node)
+{
+	while (node)
+	{
+		PieceSolidificationGroup* group = node->GetComponent<PieceSolidificationGroup>();
+		if (group && group->IsLodGroup())
+			return group;
+		node = node->GetParent();
+	}
+	return nullptr;
+}
+
+//child of the scene that node is under.
+static Node* GetTopNode(Node* node)
+{
+	Scene* scene = node->GetScene();
+	while (node->GetParent() && node->GetParent() != scene)
+		node = node->GetParent();
+	return node;
+}
+
+
+
+void PieceManager::SetLodEnabled(bool enable)
+{
+	lodEnabled_ = enable;
+	lodTimer_ = 0.0f;
+	lodIdleTimes_.clear();
+
+	if (!enable)
+		WakeAllContraptions();
+}
+
+void PieceManager::WakeContraption(Piece* piece)
+{
+	PromoteContraption(piece);
+
+	if (PieceSolidificationGroup* group = GetLodGroup(piece->GetNode()))
+		WakeLodGroup(group);
+}
+
+void PieceManager::WakeAllContraptions()
+{
+	ea::vector<LodContraption> contraptions = lodContraptions_;
+	for (LodContraption& contraption : contraptions)
+	{
+		if (contraption.group_)
+			WakeLodGroup(contraption.group_);
+	}
+	lodContraptions_.clear();
+}
+
+void PieceManager::WakeLodGroup(PieceSolidificationGroup* group)
+{
+	for (unsigned i = 0; i < lodContraptions_.size(); i++)
+	{
+		if (lodContraptions_[i].group_ == group)
+		{
+			lodContraptions_.erase_at(i);
+			break;
+		}
+	}
+
+	//back to the base (unsolid) state, then hand the children back to the scene.
+	group->PopSolidState();
+	RemoveSolidGroup(group);
+}
+
+void PieceManager::RestoreLodContraptions()
+{
+	lodContraptions_.clear();
+
+	//pushing the state rebuilds branches - work from a snapshot of the registry.
+	ea::vector<WeakPtr<PieceSolidificationGroup>> groups;
+	for (PieceSolidificationGroup* group : groupRegistry_.GetAll())
+	{
+		if (group->IsLodGroup())
+			groups.push_back(WeakPtr<PieceSolidificationGroup>(group));
+	}
+
+	for (PieceSolidificationGroup* group : groups)
+	{
+		if (!group)
+			continue;
+
+		ea::vector<Piece*> pieces;
+		group->GetPieces(pieces);
+
+		Vector3 center = group->GetNode()->GetWorldPosition();
+		float radius = 0.0f;
+		for (Piece* piece : pieces)
+			radius = Max(radius, (piece->GetNode()->GetWorldPosition() - center).Length());
+
+		//only the wrapper's own state is saved - rebuild the stack it had: unsolid base, solid pushed on top.
+		group->SetSolidStateAttrib(false);
+		group->PushSolidState(true);
+
+		//why it was wrapped is not saved - counting it as distant wakes it as soon as the viewer is near.
+		LodContraption contraption;
+		contraption.group_ = group;
+		contraption.radius_ = radius;
+		contraption.idle_ = false;
+		lodContraptions_.push_back(contraption);
+	}
+}
+
+void PieceManager::SolidifyContraptionLod(const ea::vector<Piece*>& pieces, const Vector3& center, float radius, bool idle)
+{
+	ea::vector<Node*> topNodes;
+	for (Piece* piece : pieces)
+	{
+		Node* topNode = GetTopNode(piece->GetNode());
+		if (!topNodes.contains(topNode))
+			topNodes.push_back(topNode);
+	}
+
+	Node* node = GetScene()->CreateChild();
+	node->SetWorldPosition(center);
+	PieceSolidificationGroup* group = node->CreateComponent<PieceSolidificationGroup>();
+	group->SetLodGroup(true);
+	group->SetSolidStateAttrib(false);
+
+	//pushing the state rebuilds the wrapper's branch once.
+	SuspendNodeRebuilds();
+	for (Node* topNode : topNodes)
+		topNode->SetParent(node);
+	ResumeNodeRebuilds();
+
+	group->PushSolidState(true);
+
+	LodContraption contraption;
+	contraption.group_ = group;
+	contraption.radius_ = radius;
+	contraption.idle_ = idle;
+	lodContraptions_.push_back(contraption);
+}
+
+void PieceManager::UpdateLod(float timeStep)
+{
+	Vector3 viewerPosition;
+	bool hasViewer = !lodViewer_.Expired();
+	if (hasViewer)
+		viewerPosition = lodViewer_->GetWorldPosition();
+
+	//wake solidified contraptions that came back into range or got knocked into motion.
+	ea::vector<LodContraption> contraptions = lodContraptions_;
+	for (LodContraption& contraption : contraptions)
+	{
+		PieceSolidificationGroup* group = contraption.group_;
+		if (!group)
+			continue;
+
+		bool wake = false;
+		if (!contraption.idle_ && hasViewer)
+		{
+			float distance = (group->GetNode()->GetWorldPosition() - viewerPosition).Length() - contraption.radius_;
+			wake = distance < lodDistance_ * lodWakeDistanceFactor_;
+		}
+
+		NewtonRigidBody* body = group->GetRigidBody();
+		if (body && (body->GetLinearVelocity(TS_WORLD).Length() > lodWakeSpeed_ || body->GetAngularVelocity(TS_WORLD).Length() > lodWakeSpeed_))
+			wake = true;
+
+		if (wake)
+			WakeLodGroup(group);
+	}
+
+	for (unsigned i = 0; i < lodContraptions_.size();)
+	{
+		if (!lodContraptions_[i].group_)
+			lodContraptions_.erase_at(i);
+		else
+			i++;
+	}
+
+
+	//solidify contraptions that are far away or have been idle long enough.
+	ea::hash_map<unsigned, float> idleTimes;
+	ea::vector<ea::vector<Piece*>> contraptions;
+	GetContraptions(contraptions);
+	for (const ea::vector<Piece*>& pieces : contraptions)
+	{
+		if (pieces.size() < 2)
+			continue;
+
+		Vector3 center;
+		unsigned key = M_MAX_UNSIGNED;
+		bool skip = false;
+		float maxSpeed = 0.0f;
+		for (Piece* piece : pieces)
+		{
+			center += piece->GetNode()->GetWorldPosition();
+			key = Min(key, piece->GetNode()->GetID());
+
+			//held by a tool, already inside a LOD wrapper, frozen (the frozen state lives on bodies the wrapper would remove) or rate scheduled.
+			NewtonRigidBody* body = GetActiveBody(piece);
+			if (piece->GetGhostingEffectEnabled() || GetLodGroup(piece->GetNode()) || !body || body->GetMassScale() <= 0.0f || scheduledBodies_.contains(body))
+			{
+				skip = true;
+				break;
+			}
+
+			maxSpeed = Max(maxSpeed, body->GetLinearVelocity(TS_WORLD).Length());
+			maxSpeed = Max(maxSpeed, body->GetAngularVelocity(TS_WORLD).Length());
+		}
+		if (skip)
+			continue;
+
+		center /= float(pieces.size());
+
+		float radius = 0.0f;
+		for (Piece* piece : pieces)
+			radius = Max(radius, (piece->GetNode()->GetWorldPosition() - center).Length());
+
+		//already one body - nothing to gain.
+		PieceSolidificationGroup* commonGroup = GetCommonSolidGroup(pieces);
+		if (commonGroup && commonGroup->GetEffectivelySolidified())
+			continue;
+
+		float idleTime = 0.0f;
+		if (maxSpeed < lodIdleSpeed_)
+		{
+			auto it = lodIdleTimes_.find(key);
+			idleTime = (it != lodIdleTimes_.end() ? it->second : 0.0f) + timeStep;
+		}
+
+		bool distant = hasViewer && (center - viewerPosition).Length() - radius > lodDistance_;
+		bool idle = idleTime >= lodIdleTime_;
+		if (distant || idle)
+			SolidifyContraptionLod(pieces, center, radius, !distant);
+		else
+			idleTimes.insert_or_assign(key, idleTime);
+	}
+	lodIdleTimes_ = ea::move(idleTimes);
+}
@@ -0,0 +1,332 @@
+#include "PieceManager.h"
+#include "Piece.h"
+#include "PieceSolidificationGroup.h"
+
+#include "NewtonPhysicsWorld.h"
+#include "NewtonRigidBody.h"
+
+
+
+//lowest piece node id - the same key the LOD idle timers use.
+static unsigned GetContraptionKey(const ea::vector<Piece*>& pieces)
+{
+	unsigned key = M_MAX_UNSIGNED;
+	for (Piece* piece : pieces)
+		key = Min(key, piece->GetNode()->GetID());
+	return key;
+}
+
+
+
+void PieceManager::SetRateSchedulingEnabled(bool enable)
+{
+	rateSchedulingEnabled_ = enable;
+	rateTimer_ = 0.0f;
+
+	if (enable)
+		GetScene()->GetOrCreateComponent<PhysicsContactStream>();
+
+	if (!enable)
+		PromoteAllContraptions();
+}
+
+void PieceManager::PromoteContraption(Piece* piece)
+{
+	if (scheduledContraptions_.empty())
+		return;
+
+	NewtonRigidBody* body = piece->GetEffectiveRigidBody();
+	auto it = scheduledBodies_.find(body);
+	if (it != scheduledBodies_.end())
+		PromoteScheduled(it->second);
+}
+
+void PieceManager::PromoteAllContraptions()
+{
+	while (!scheduledContraptions_.empty())
+		PromoteScheduled(scheduledContraptions_.begin()->first);
+}
+
+unsigned PieceManager::GetNumReducedRateContraptions() const
+{
+	unsigned count = 0;
+	for (const auto& entry : scheduledContraptions_)
+	{
+		if (entry.second.rate_ == ContraptionSimRate_Reduced)
+			count++;
+	}
+	return count;
+}
+
+unsigned PieceManager::GetNumFrozenRateContraptions() const
+{
+	return scheduledContraptions_.size() - GetNumReducedRateContraptions();
+}
+
+void PieceManager::ScheduleContraption(unsigned key, const ea::vector<Piece*>& pieces, ContraptionSimRate rate)
+{
+	ScheduledContraption contraption;
+	contraption.rate_ = rate;
+	contraption.phase_ = key % reducedRateInterval_;
+
+	for (Piece* piece : pieces)
+	{
+		NewtonRigidBody* body = piece->GetEffectiveRigidBody();
+		if (scheduledBodies_.contains(body))
+			continue;
+
+		BodyMotion motion;
+		motion.linear_ = body->GetLinearVelocity(TS_WORLD);
+		motion.angular_ = body->GetAngularVelocity(TS_WORLD);
+
+		//held still until the next solve step.  a kinematic body moving on its own velocity has no gravity, goes through the ground
+		//and shoves everything it meets with infinite mass - holding it still does none of that.
+		body->SetIsKinematic(true);
+		body->SetLinearVelocity(Vector3::ZERO, false);
+		body->SetAngularVelocity(Vector3::ZERO);
+
+		contraption.bodies_.push_back(WeakPtr<NewtonRigidBody>(body));
+		contraption.motion_.push_back(motion);
+		scheduledBodies_[body] = key;
+	}
+
+	scheduledContraptions_[key] = ea::move(contraption);
+}
+
+void PieceManager::PromoteScheduled(unsigned key)
+{
+	auto it = scheduledContraptions_.find(key);
+	if (it == scheduledContraptions_.end())
+		return;
+
+	ScheduledContraption& contraption = it->second;
+	for (unsigned i = 0; i < contraption.bodies_.size(); i++)
+	{
+		NewtonRigidBody* body = contraption.bodies_[i];
+		if (!body)
+			continue;
+
+		//a reduced contraption in its solve step is already dynamic - only its velocity is scaled.
+		if (contraption.solving_)
+		{
+			BodyMotion motion;
+			GetSolvedMotion(contraption, body, motion);
+			body->SetLinearVelocity(motion.linear_, false);
+			body->SetAngularVelocity(motion.angular_);
+			continue;
+		}
+
+		body->SetIsKinematic(false);
+		body->SetLinearVelocity(contraption.motion_[i].linear_, false);
+		body->SetAngularVelocity(contraption.motion_[i].angular_);
+	}
+
+	//by key - expired bodies are in there too.
+	for (auto bodyIt = scheduledBodies_.begin(); bodyIt != scheduledBodies_.end();)
+	{
+		if (bodyIt->second == key)
+			bodyIt = scheduledBodies_.erase(bodyIt);
+		else
+			++bodyIt;
+	}
+
+	scheduledContraptions_.erase(it);
+}
+
+void PieceManager::GetSolvedMotion(const ScheduledContraption& contraption, NewtonRigidBody* body, BodyMotion& motion) const
+{
+	//the solve step applied one step of gravity to the scaled velocity - add the rest of the interval's.
+	NewtonPhysicsWorld* physicsWorld = GetScene()->GetComponent<NewtonPhysicsWorld>();
+	Vector3 gravity = physicsWorld ? physicsWorld->GetGravity() : Vector3::ZERO;
+	float scale = contraption.solveScale_;
+
+	motion.linear_ = body->GetLinearVelocity(TS_WORLD) / scale + gravity * rateTimeStep_ * (scale - 1.0f / scale);
+	motion.angular_ = body->GetAngularVelocity(TS_WORLD) / scale;
+}
+
+void PieceManager::StepRateSchedule(float timeStep)
+{
+	rateStep_++;
+
+	for (auto& entry : scheduledContraptions_)
+	{
+		ScheduledContraption& contraption = entry.second;
+		if (contraption.rate_ != ContraptionSimRate_Reduced)
+			continue;
+
+		bool solve = (rateStep_ + contraption.phase_) % reducedRateInterval_ == 0;
+		if (solve == contraption.solving_)
+			continue;
+
+		if (solve)
+		{
+			contraption.resumeStep_ = rateStep_;
+			contraption.solveScale_ = float(reducedRateInterval_);
+		}
+
+		for (unsigned i = 0; i < contraption.bodies_.size(); i++)
+		{
+			NewtonRigidBody* body = contraption.bodies_[i];
+			if (!body)
+				continue;
+
+			if (solve)
+			{
+				//one step stands in for the whole interval: it runs interval times as fast, so the contraption covers the
+				//time it was held and keeps pace with the rest of the scene.
+				body->SetIsKinematic(false);
+				body->SetLinearVelocity(contraption.motion_[i].linear_ * contraption.solveScale_, false);
+				body->SetAngularVelocity(contraption.motion_[i].angular_ * contraption.solveScale_);
+			}
+			else
+			{
+				//keep the solved velocity, back at normal speed, for the next solve step and hold still until then.
+				GetSolvedMotion(contraption, body, contraption.motion_[i]);
+				body->SetIsKinematic(true);
+				body->SetLinearVelocity(Vector3::ZERO, false);
+				body->SetAngularVelocity(Vector3::ZERO);
+			}
+		}
+		contraption.solving_ = solve;
+	}
+
+	//the step about to run - a solve step started now is scaled back with it.
+	rateTimeStep_ = timeStep;
+}
+
+void PieceManager::UpdateRateSchedule()
+{
+	//attach/detach changed what a contraption is - start over from full rate.
+	if (rateScheduleVersion_ != connectivityVersion_)
+	{
+		PromoteAllContraptions();
+		rateScheduleVersion_ = connectivityVersion_;
+	}
+
+	Vector3 viewerPosition;
+	bool hasViewer = !lodViewer_.Expired();
+	if (hasViewer)
+		viewerPosition = lodViewer_->GetWorldPosition();
+
+	float time = GetScene()->GetElapsedTime();
+	for (auto it = rateContactHolds_.begin(); it != rateContactHolds_.end();)
+	{
+		if (it->second <= time)
+			it = rateContactHolds_.erase(it);
+		else
+			++it;
+	}
+
+	ea::vector<ea::vector<Piece*>> contraptions;
+	GetContraptions(contraptions);
+	for (const ea::vector<Piece*>& pieces : contraptions)
+	{
+		if (pieces.empty())
+			continue;
+
+		unsigned key = GetContraptionKey(pieces);
+		auto scheduled = scheduledContraptions_.find(key);
+		ContraptionSimRate currentRate = scheduled != scheduledContraptions_.end() ? scheduled->second.rate_ : ContraptionSimRate_Full;
+
+		Vector3 center;
+		bool skip = false;
+		for (Piece* piece : pieces)
+		{
+			center += piece->GetNode()->GetWorldPosition();
+
+			//held by a tool, frozen, LOD solidified (the effective body is the wrapper's), or its bodies were switched since it was scheduled.
+			NewtonRigidBody* body = piece->GetEffectiveRigidBody();
+			if (piece->GetGhostingEffectEnabled() || !body || body->GetMassScale() <= 0.0f)
+			{
+				skip = true;
+				break;
+			}
+
+			PieceSolidificationGroup* bodyGroup = body->GetNode()->GetComponent<PieceSolidificationGroup>();
+			bool ours = scheduledBodies_.contains(body);
+			if ((bodyGroup && bodyGroup->IsLodGroup()) || ours != (currentRate != ContraptionSimRate_Full))
+			{
+				skip = true;
+				break;
+			}
+		}
+		if (skip)
+		{
+			if (currentRate != ContraptionSimRate_Full)
+				PromoteScheduled(key);
+			continue;
+		}
+
+		center /= float(pieces.size());
+
+		float radius = 0.0f;
+		for (Piece* piece : pieces)
+			radius = Max(radius, (piece->GetNode()->GetWorldPosition() - center).Length());
+
+		//going back to a higher rate needs the viewer a bit closer than leaving it did, so the border does not flicker.
+		float distance = hasViewer ? (center - viewerPosition).Length() - radius : 0.0f;
+		float wakeFactor = currentRate == ContraptionSimRate_Full ? 1.0f : rateWakeDistanceFactor_;
+		bool offScreen = scheduleCamera_ && hasViewer && distance > offScreenRateDistance_ * wakeFactor
+			&& scheduleCamera_->GetFrustum().IsInsideFast(Sphere(center, radius)) == OUTSIDE;
+
+		ContraptionSimRate rate = ContraptionSimRate_Full;
+		if (rateContactHolds_.contains(key))
+			rate = ContraptionSimRate_Full;
+		else if (hasViewer && distance > frozenRateDistance_ * (currentRate == ContraptionSimRate_Frozen ? rateWakeDistanceFactor_ : 1.0f))
+			rate = ContraptionSimRate_Frozen;
+		else if (offScreen || (hasViewer && distance > reducedRateDistance_ * wakeFactor))
+			rate = ContraptionSimRate_Reduced;
+
+		if (rate == currentRate)
+			continue;
+
+		if (currentRate != ContraptionSimRate_Full)
+			PromoteScheduled(key);
+		if (rate != ContraptionSimRate_Full)
+			ScheduleContraption(key, pieces, rate);
+	}
+}
+
+void PieceManager::HandlePhysicsContacts(StringHash event, VariantMap& eventData)
+{
+	using namespace PhysicsContacts;
+
+	if (scheduledContraptions_.empty() || GetEventSender() != GetScene()->GetComponent<PhysicsContactStream>())
+		return;
+
+	PhysicsContactStream* stream = static_cast<PhysicsContactStream*>(eventData[P_STREAM].GetPtr());
+	for (const PhysicsContact& contact : stream->GetContacts())
+	{
+		NewtonRigidBody* bodyA = contact.bodyA_;
+		NewtonRigidBody* bodyB = contact.bodyB_;
+		if (!bodyA || !bodyB)
+			continue;
+
+		auto itA = scheduledBodies_.find(bodyA);
+		auto itB = scheduledBodies_.find(bodyB);
+		unsigned keyA = itA != scheduledBodies_.end() ? itA->second : M_MAX_UNSIGNED;
+		unsigned keyB = itB != scheduledBodies_.end() ? itB->second : M_MAX_UNSIGNED;
+		if (keyA == keyB)
+			continue;
+
+		//any new contact wakes a contraption, the ground included.
+		if (keyA != M_MAX_UNSIGNED)
+			PromoteOnContact(keyA, bodyB);
+		if (keyB != M_MAX_UNSIGNED)
+			PromoteOnContact(keyB, bodyA);
+	}
+}
+
+void PieceManager::PromoteOnContact(unsigned key, NewtonRigidBody* other)
+{
+	auto it = scheduledContraptions_.find(key);
+	if (it == scheduledContraptions_.end())
+		return;
+
+	//a contraption resuming from a hold makes its resting contacts again - those are not new.
+	if (it->second.solving_ && it->second.resumeStep_ == rateStep_ && other->GetMassScale() <= 0.0f)
+		return;
+
+	PromoteScheduled(key);
+	rateContactHolds_[key] = GetScene()->GetElapsedTime() + rateContactHoldTime_;
+}
@@ -6,10 +6,144 @@
 #include "PieceManager.h"
 #include "PieceGear.h"
 #include "NewtonRevoluteJoint.h"
+#include "PieceCatalog.h"
+
+
+//every name handled by the procedural branches of CreatePiece.  keep in sync - the catalog build step spawns exactly these.
+static const char* ProceduralPieceNames[] = {
+	"8_piece_Cshape",
+	"2_sleeve",
+	"1_cap_small",
+	"gear_large",
+	"gear_extra_large",
+	"gear_medium",
+	"gear_small",
+	"4x4_piece_thin",
+	"4x8_piece_thin",
+	"6_piece_thin",
+	"6_piece_thick",
+	"5_piece_thick",
+	"4_piece_thick",
+	"3_piece_thick",
+	"2_piece_thick",
+	"rod_round_1",
+	"rod_hard_1",
+	"corner_hard_1",
+	"rod_round_4",
+	"rod_round_no_caps_4",
+	"rod_hard_4"
+};
+
+void PieceManager::GetProceduralPieceNames(ea::vector<ea::string>& names)
+{
+	for (const char* name : ProceduralPieceNames)
+		names.push_back(name);
+}
+
+void PieceManager::GetPieceResources(ea::vector<ea::pair<StringHash, ea::string>>& resources)
+{
+	for (const char* name : ProceduralPieceNames)
+		resources.push_back({ Model::GetTypeStatic(), ea::string("Models/") + name + ".mdl" });
+
+	//assembly parts (CreatePieceAssembly)
+	resources.push_back({ Model::GetTypeStatic(), "Models/outerhousing.mdl" });
+	resources.push_back({ Model::GetTypeStatic(), "Models/InnerRotationalDrive.mdl" });
+
+	//Piece::RefreshVisualMaterial
+	resources.push_back({ Material::GetTypeStatic(), "Materials/Piece.xml" });
+	resources.push_back({ Technique::GetTypeStatic(), "Techniques/Diff.xml" });
+	resources.push_back({ Technique::GetTypeStatic(), "Techniques/DiffEmissiveAlpha.xml" });
+}
+
+Node* PieceManager::CreatePieceFromCatalog(const PieceCatalogEntry& entry)
+{
+	Node* root = GetScene()->CreateChild();
+	root->SetVar("PieceName", entry.name_);
+
+	auto* body = root->CreateComponent<NewtonRigidBody>();
+	body->SetMassScale(entry.massScale_);
+
+	Node* visualNode = root->CreateChild("visualNode");
+	StaticModel* staticMdl = visualNode->CreateComponent<StaticModel>();
+	visualNode->SetScale(entry.visualScale_);
+	staticMdl->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>(entry.modelName_));
+	staticMdl->SetCastShadows(true);
+
+	for (const PieceCatalogEntry::Shape& shape : entry.shapes_)
+	{
+		NewtonCollisionShape* collisionShape;
+		if (shape.type_ == PieceCatalogEntry::ShapeType_Cylinder)
+		{
+			auto* cylinder = root->CreateComponent<NewtonCollisionShape_Cylinder>();
+			cylinder->SetRadius(shape.radius_);
+			cylinder->SetLength(shape.length_);
+			collisionShape = cylinder;
+		}
+		else
+		{
+			collisionShape = root->CreateComponent<NewtonCollisionShape_Box>();
+		}
+
+		collisionShape->SetScaleFactor(shape.scaleFactor_);
+		collisionShape->SetPositionOffset(shape.positionOffset_);
+		collisionShape->SetRotationOffset(shape.rotationOffset_);
+	}
 
+	ea::vector<PiecePoint*> points;
+	for (const PieceCatalogEntry::Point& catalogPoint : entry.points_)
+	{
+		Node* pointNode = root->CreateChild();
+		pointNode->SetPosition(catalogPoint.position_);
+		pointNode->SetRotation(catalogPoint.rotation_);
+
+		PiecePoint* point = pointNode->CreateComponent<PiecePoint>();
+		point->direction_ = catalogPoint.direction_;
+		point->isEndCap_ = catalogPoint.isEndCap_;
+		points.push_back(point);
+	}
+
+	for (const PieceCatalogEntry::Row& catalogRow : entry.rows_)
+	{
+		PiecePointRow* pointRow = root->CreateComponent<PiecePointRow>();
+		for (unsigned index : catalogRow.points_)
+			pointRow->PushBack(points[index]);
+
+		pointRow->SetRowType(PiecePointRow::RowType(catalogRow.rowType_));
+		pointRow->SetRowDirectionLocal(catalogRow.localDirection_);
+		pointRow->SetPiecePlaner(catalogRow.piecePlaner_);
+		pointRow->Finalize();
+	}
+
+	for (const PieceCatalogEntry::Gear& catalogGear : entry.gears_)
+	{
+		PieceGear* gear = root->CreateComponent<PieceGear>();
+		gear->SetRadius(catalogGear.radius_);
+		gear->SetNormal(catalogGear.normal_);
+	}
+
+	Piece* piece = root->CreateComponent<Piece>();
+	piece->SetColorPalletId(StringHash(entry.palletId_));
+
+	return root;
+}
 
 Node* PieceManager::CreatePiece(ea::string name, bool loadExisting)
 {
+	if (!loadExisting && usePieceCatalog_)
+	{
+		PieceCatalog* catalog = GetSubsystem<PieceCatalog>();
+		const PieceCatalogEntry* entry = catalog ? catalog->GetEntry(name) : nullptr;
+		if (entry && Equals(catalog->GetScaleFactor(), GetScaleFactor()))
+			return CreatePieceFromCatalog(*entry);
+	}
+
+	if (!loadExisting && usePiecePrototypes_)
+	{
+		auto prototype = piecePrototypes_.find(StringHash(name));
+		if (prototype != piecePrototypes_.end())
+			return CreatePieceFromCatalog(prototype->second);
+	}
+
 	Node* root;
 
 	if (loadExisting)
@@ -1042,6 +1176,13 @@ Node* PieceManager::CreatePiece(ea::string name, bool loadExisting)
 		Piece* piece = root->CreateComponent<Piece>();
 		piece->SetColorPalletId(palletId);
 
+		//keep what was just built as the prototype for the next spawn of this type.
+		if (usePiecePrototypes_)
+		{
+			PieceCatalogEntry prototype;
+			if (PieceCatalog::CaptureEntry(root, prototype))
+				piecePrototypes_.insert_or_assign(StringHash(name), prototype);
+		}
 
 		//SharedPtr<File> file = SharedPtr<File>(new File(context_));
 		//file->Open(name + ".xml", FILE_WRITE);
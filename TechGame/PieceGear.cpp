@@ -6,7 +6,6 @@
 
 PieceGear::PieceGear(Context* context) : Component(context)
 {
-	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(PieceGear, HandleUpdate));
 }
 
 void PieceGear::RegisterObject(Context* context)
@@ -14,7 +13,7 @@ void PieceGear::RegisterObject(Context* context)
 	context->RegisterFactory<PieceGear>();
 }
 
-void PieceGear::HandleUpdate(StringHash event, VariantMap& eventData)
+void PieceGear::Tick()
 {
 
 
@@ -201,13 +200,10 @@ void PieceGear::OnNodeSet(Node* node)
 {
 	if (node)
 	{
-
-
+		PieceManager::RegisterComponent(this);
 	}
 	else
 	{
-
-
-
+		PieceManager::UnRegisterComponent(this);
 	}
 }
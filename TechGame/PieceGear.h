@@ -27,7 +27,8 @@ public:
 
 	Vector3 GetWorldNormal() const { return node_->GetWorldRotation() * normal_; }
 
-	void HandleUpdate(StringHash event, VariantMap& eventData);
+	///called by PieceManager once per frame, or per physics step in fixed step mode.
+	void Tick();
 
 	void ReEvalConstraints();
 
@@ -38,6 +39,9 @@ public:
 
 	virtual void OnSetEnabled() override;
 
+	//slot in the PieceManager registry (maintained in OnNodeSet).
+	PieceRegistryHandle registryHandle_;
+
 protected:
 
 	int refreshCounter_ = PIECEGEAR_REFRESH_CNT;
@@ -0,0 +1,230 @@
+#include "PieceManager.h"
+#include "Piece.h"
+#include "PiecePointRow.h"
+#include "PieceSolidificationGroup.h"
+
+#include "NewtonRigidBody.h"
+
+
+
+//true if node is a LOD wrapper or under one.
+static bool IsInLodGroup(Node* node)
+{
+	for (; node; node = node->GetParent())
+	{
+		PieceSolidificationGroup* group = node->GetComponent<PieceSolidificationGroup>();
+		if (group && group->IsLodGroup())
+			return true;
+	}
+	return false;
+}
+
+
+
+PieceManager::~PieceManager()
+{
+	CancelGroupFormation();
+}
+
+void PieceManager::RequestAutoFormAllGroups()
+{
+	//coalesces - any number of requests before the next frame (or while a job is running) result in one re-formation.
+	groupFormationRequested_ = true;
+}
+
+void PieceManager::GroupFormationWork(const WorkItem* item, unsigned threadIndex)
+{
+	GroupFormationJob* job = reinterpret_cast<GroupFormationJob*>(item->aux_);
+
+	unsigned numPieces = job->pieceNodes_.size();
+	job->keepGroups_.resize(job->groupNodes_.size(), false);
+
+	ea::vector<bool> visited(numPieces, false);
+	ea::vector<unsigned> stack;
+	for (unsigned i = 0; i < numPieces; i++)
+	{
+		if (visited[i])
+			continue;
+
+		ea::vector<unsigned> cluster;
+		stack.push_back(i);
+		visited[i] = true;
+		while (!stack.empty())
+		{
+			unsigned p = stack.back();
+			stack.pop_back();
+			cluster.push_back(p);
+
+			for (unsigned n : job->rigidNeighbors_[p])
+			{
+				if (!visited[n])
+				{
+					visited[n] = true;
+					stack.push_back(n);
+				}
+			}
+		}
+
+		//single pieces stay loose.
+		if (cluster.size() < 2)
+			continue;
+
+		//an existing group that holds exactly this cluster and nothing else is left alone.
+		unsigned group = job->pieceGroups_[cluster.front()];
+		bool sameGroup = group != M_MAX_UNSIGNED && job->groupSizes_[group] == cluster.size();
+		for (unsigned p : cluster)
+		{
+			if (!sameGroup)
+				break;
+			sameGroup = job->pieceGroups_[p] == group;
+		}
+
+		if (sameGroup)
+			job->keepGroups_[group] = true;
+		else
+			job->newClusters_.push_back(ea::move(cluster));
+	}
+}
+
+void PieceManager::StartGroupFormation()
+{
+	groupFormationRequested_ = false;
+
+	SharedPtr<GroupFormationJob> job(new GroupFormationJob());
+	job->connectivityVersion_ = connectivityVersion_;
+	job->groupVersion_ = groupVersion_;
+
+	//LOD wrapped contraptions are left as they are - the wrapper must only ever be removed by waking it.
+	ea::vector<Piece*> pieces;
+	for (Piece* piece : pieceRegistry_.GetAll())
+	{
+		if (!IsInLodGroup(piece->GetNode()))
+			pieces.push_back(piece);
+	}
+
+	ea::hash_map<Piece*, unsigned> pieceIndices;
+	for (unsigned i = 0; i < pieces.size(); i++)
+	{
+		pieceIndices[pieces[i]] = i;
+		job->pieceNodes_.push_back(WeakPtr<Node>(pieces[i]->GetNode()));
+	}
+
+	//only top level groups can be kept - nested ones are flattened like AutoFormAllGroups does.
+	ea::hash_map<PieceSolidificationGroup*, unsigned> groupIndices;
+	for (PieceSolidificationGroup* group : groupRegistry_.GetAll())
+	{
+		if (IsInLodGroup(group->GetNode()))
+			continue;
+
+		groupIndices[group] = job->groupNodes_.size();
+		job->groupNodes_.push_back(WeakPtr<Node>(group->GetNode()));
+
+		//pieces and sub groups only - helper nodes such as the merged visual don't count.
+		unsigned size = 0;
+		for (Node* child : group->GetNode()->GetChildren())
+		{
+			if (child->HasComponent<Piece>() || child->HasComponent<PieceSolidificationGroup>())
+				size++;
+		}
+		job->groupSizes_.push_back(group->GetNode()->GetParent() == GetScene() ? size : M_MAX_UNSIGNED);
+	}
+
+	//the degree of freedom checks read row state, so the edges are resolved here and the worker only sees indices.
+	job->rigidNeighbors_.resize(pieces.size());
+	job->pieceGroups_.resize(pieces.size(), M_MAX_UNSIGNED);
+	for (unsigned i = 0; i < pieces.size(); i++)
+	{
+		Piece* piece = pieces[i];
+		if (PieceSolidificationGroup* group = piece->GetPieceGroup())
+			job->pieceGroups_[i] = groupIndices[group];
+
+		ea::vector<PiecePointRow*> rows;
+		piece->GetPointRows(rows);
+		for (PiecePointRow* row : rows)
+		{
+			ea::vector<PiecePointRow*> attachedRows;
+			row->GetAttachedRows(attachedRows);
+			for (PiecePointRow* attachedRow : attachedRows)
+			{
+				if (PiecePointRow::RowsHaveDegreeOfFreedom(row, attachedRow))
+					continue;
+
+				auto it = pieceIndices.find(attachedRow->GetPiece());
+				if (it == pieceIndices.end())
+					continue;
+
+				job->rigidNeighbors_[i].push_back(it->second);
+				job->rigidNeighbors_[it->second].push_back(i);
+			}
+		}
+	}
+
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	groupFormationItem_ = queue->GetFreeItem();
+	groupFormationItem_->workFunction_ = GroupFormationWork;
+	groupFormationItem_->aux_ = job.Get();
+	groupFormationItem_->sendEvent_ = false;
+	groupFormationJob_ = job;
+
+	queue->AddWorkItem(groupFormationItem_);
+}
+
+void PieceManager::FinishGroupFormation()
+{
+	SharedPtr<GroupFormationJob> job = groupFormationJob_;
+	groupFormationJob_ = nullptr;
+	groupFormationItem_ = nullptr;
+
+	//pieces attached, detached, added or removed since the snapshot, groups formed, removed, solidified or LOD wrapped since (drop, undo,
+	//manual solidify, LOD wrap/wake) - or another request came in.  try again next frame.
+	if (job->connectivityVersion_ != connectivityVersion_ || job->groupVersion_ != groupVersion_ || groupFormationRequested_)
+	{
+		groupFormationRequested_ = true;
+		return;
+	}
+
+	for (unsigned g = 0; g < job->groupNodes_.size(); g++)
+	{
+		if (job->keepGroups_[g] || job->groupNodes_[g].Expired())
+			continue;
+
+		RemoveSolidGroup(job->groupNodes_[g]->GetComponent<PieceSolidificationGroup>());
+	}
+
+	for (const ea::vector<unsigned>& cluster : job->newClusters_)
+	{
+		ea::vector<Piece*> pieces;
+		bool frozen = false;
+		for (unsigned p : cluster)
+		{
+			Piece* piece = job->pieceNodes_[p]->GetComponent<Piece>();
+			pieces.push_back(piece);
+
+			//if part of the contraption was frozen - make the new group frozen too.
+			if (piece->GetRigidBody()->GetMassScale() <= 0.0f)
+				frozen = true;
+		}
+
+		PieceSolidificationGroup* newGroup = CreateGroupNode(GetScene(), pieces.front()->GetNode()->GetWorldPosition())->GetComponent<PieceSolidificationGroup>();
+		MovePiecesToSolidGroup(pieces, newGroup);
+
+		if (frozen && newGroup->GetRigidBody())
+			newGroup->GetRigidBody()->SetMassScale(0.0f);
+	}
+}
+
+void PieceManager::CancelGroupFormation()
+{
+	if (!groupFormationItem_)
+		return;
+
+	//the job must not be freed while a worker is still reading from it.
+	if (!groupFormationItem_->completed_ && !GetSubsystem<WorkQueue>()->RemoveWorkItem(groupFormationItem_))
+	{
+		while (!groupFormationItem_->completed_)
+			Time::Sleep(0);
+	}
+
+	groupFormationItem_ = nullptr;
+	groupFormationJob_ = nullptr;
+}
@@ -0,0 +1,466 @@
+#include "PieceGroupMergedCollision.h"
+#include "Piece.h"
+
+#include "NewtonCollisionShapesDerived.h"
+
+#include "EASTL/sort.h"
+
+
+//boxes closer than this (group node space) count as touching / having the same cross section.
+static const float MERGE_TOLERANCE = 0.001f;
+
+
+
+static float GetAxis(const Vector3& v, unsigned axis)
+{
+	return axis == 0 ? v.x_ : (axis == 1 ? v.y_ : v.z_);
+}
+
+static float& GetAxis(Vector3& v, unsigned axis)
+{
+	return axis == 0 ? v.x_ : (axis == 1 ? v.y_ : v.z_);
+}
+
+static int Quantize(float value)
+{
+	return RoundToInt(value / MERGE_TOLERANCE);
+}
+
+static unsigned HashQuantized(unsigned hash, const Vector3& v)
+{
+	hash = hash * 31 + Quantize(v.x_);
+	hash = hash * 31 + Quantize(v.y_);
+	return hash * 31 + Quantize(v.z_);
+}
+
+
+
+PieceGroupMergedCollision::PieceGroupMergedCollision(Context* context) : Component(context)
+{
+}
+
+void PieceGroupMergedCollision::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PieceGroupMergedCollision>();
+}
+
+void PieceGroupMergedCollision::ComputePieceBoxes(Node* pieceNode, const Matrix3x4& groupInverse, PieceBoxes& pieceBoxes) const
+{
+	Matrix3x4 pieceTransform = groupInverse * pieceNode->GetWorldTransform();
+	unsigned pieceId = pieceNode->GetID();
+
+	ea::vector<NewtonCollisionShape_Box*> pieceShapes;
+	pieceNode->GetComponents<NewtonCollisionShape_Box>(pieceShapes);
+	for (NewtonCollisionShape_Box* shape : pieceShapes)
+	{
+		Matrix3x4 transform = pieceTransform * Matrix3x4(shape->GetPositionOffset(), shape->GetRotationOffset(), shape->GetScaleFactor());
+		Matrix3 rotationScale = transform.ToMatrix3();
+
+		Vector3 axes[3] = {
+			Vector3(rotationScale.m00_, rotationScale.m10_, rotationScale.m20_),
+			Vector3(rotationScale.m01_, rotationScale.m11_, rotationScale.m21_),
+			Vector3(rotationScale.m02_, rotationScale.m12_, rotationScale.m22_)
+		};
+
+		//a box is the same box under any signed permutation of its axes - pick the one closest to the group axes
+		//so boxes rotated by multiples of 90 degrees end up with the same orientation.
+		float extents[3];
+		unsigned dominant[3];
+		bool valid = true;
+		for (unsigned i = 0; i < 3; i++)
+		{
+			extents[i] = axes[i].Length();
+			if (extents[i] < M_EPSILON)
+			{
+				valid = false;
+				break;
+			}
+			axes[i] /= extents[i];
+
+			Vector3 absAxis = axes[i].Abs();
+			dominant[i] = absAxis.x_ >= absAxis.y_ && absAxis.x_ >= absAxis.z_ ? 0 : (absAxis.y_ >= absAxis.z_ ? 1 : 2);
+			if (GetAxis(axes[i], dominant[i]) < 0.0f)
+				axes[i] = -axes[i];
+		}
+
+		//sheared (non uniformly scaled parent) shapes are left as they are.
+		if (!valid || Abs(axes[0].DotProduct(axes[1])) > MERGE_TOLERANCE || Abs(axes[0].DotProduct(axes[2])) > MERGE_TOLERANCE
+			|| Abs(axes[1].DotProduct(axes[2])) > MERGE_TOLERANCE)
+			continue;
+
+		unsigned order[3] = { 0, 1, 2 };
+		ea::stable_sort(order, order + 3, [&dominant](unsigned a, unsigned b) { return dominant[a] < dominant[b]; });
+
+		Vector3 xAxis = axes[order[0]];
+		Vector3 yAxis = axes[order[1]];
+		Vector3 zAxis = axes[order[2]];
+		if (xAxis.CrossProduct(yAxis).DotProduct(zAxis) < 0.0f)
+			zAxis = -zAxis;
+
+		MergeBox box;
+		box.rotation_ = Quaternion(xAxis, yAxis, zAxis);
+		Vector3 halfSize = Vector3(extents[order[0]], extents[order[1]], extents[order[2]]) * 0.5f;
+		Vector3 center = box.rotation_.Inverse() * transform.Translation();
+		box.min_ = center - halfSize;
+		box.max_ = center + halfSize;
+
+		box.sources_.push_back(ea::make_pair(pieceId, unsigned(pieceBoxes.boxes_.size())));
+
+		pieceBoxes.shapes_.push_back(WeakPtr<NewtonCollisionShape_Box>(shape));
+		pieceBoxes.boxes_.push_back(box);
+	}
+}
+
+void PieceGroupMergedCollision::Rebuild()
+{
+	//nothing joined or left - the merge in place (or the decision not to merge) still holds.
+	if (!rescan_ && changedPieces_.empty() && (merged_ || mergedBoxes_.size() >= numSourceShapes_))
+		return;
+
+	Matrix3x4 groupInverse = node_->GetWorldTransform().Inverse();
+
+	//shapes of pieces that left or joined - swapped in or out below while merged.
+	ea::vector<WeakPtr<NewtonCollisionShape_Box>> leftShapes;
+	ea::vector<WeakPtr<NewtonCollisionShape_Box>> joinedShapes;
+	ea::vector<MergeBox> boxes;
+
+	if (rescan_)
+	{
+		//from scratch with every source shape enabled.
+		Revert();
+		pieceBoxes_.clear();
+		numSourceShapes_ = 0;
+
+		ea::vector<Node*> pieceNodes;
+		node_->GetChildrenWithComponent<Piece>(pieceNodes, true);
+		for (Node* pieceNode : pieceNodes)
+		{
+			PieceBoxes& pieceBoxes = pieceBoxes_[pieceNode->GetID()];
+			ComputePieceBoxes(pieceNode, groupInverse, pieceBoxes);
+			numSourceShapes_ += pieceBoxes.shapes_.size();
+			boxes.insert(boxes.end(), pieceBoxes.boxes_.begin(), pieceBoxes.boxes_.end());
+		}
+		rescan_ = false;
+	}
+	else
+	{
+		Scene* scene = GetScene();
+		for (unsigned pieceId : changedPieces_)
+		{
+			auto it = pieceBoxes_.find(pieceId);
+			if (it != pieceBoxes_.end())
+			{
+				leftShapes.insert(leftShapes.end(), it->second.shapes_.begin(), it->second.shapes_.end());
+				numSourceShapes_ -= it->second.shapes_.size();
+				pieceBoxes_.erase(it);
+			}
+
+			Node* pieceNode = scene ? scene->GetNode(pieceId) : nullptr;
+			if (pieceNode && pieceNode->IsChildOf(node_) && pieceNode->HasComponent<Piece>())
+			{
+				PieceBoxes& pieceBoxes = pieceBoxes_[pieceId];
+				ComputePieceBoxes(pieceNode, groupInverse, pieceBoxes);
+				numSourceShapes_ += pieceBoxes.shapes_.size();
+				joinedShapes.insert(joinedShapes.end(), pieceBoxes.shapes_.begin(), pieceBoxes.shapes_.end());
+				boxes.insert(boxes.end(), pieceBoxes.boxes_.begin(), pieceBoxes.boxes_.end());
+			}
+		}
+
+		//merged boxes with a changed piece in them are broken back up into the boxes of their other pieces.  the rest are merged as they are.
+		for (const MergeBox& mergedBox : mergedBoxes_)
+		{
+			bool broken = false;
+			for (const auto& source : mergedBox.sources_)
+			{
+				if (changedPieces_.contains(source.first))
+				{
+					broken = true;
+					break;
+				}
+			}
+
+			if (!broken)
+			{
+				boxes.push_back(mergedBox);
+				continue;
+			}
+
+			for (const auto& source : mergedBox.sources_)
+			{
+				if (changedPieces_.contains(source.first))
+					continue;
+
+				auto it = pieceBoxes_.find(source.first);
+				if (it != pieceBoxes_.end() && source.second < it->second.boxes_.size())
+					boxes.push_back(it->second.boxes_[source.second]);
+			}
+		}
+	}
+	changedPieces_.clear();
+
+	MergeBoxes(boxes);
+	ea::vector<MergeBox> previousBoxes = ea::move(mergedBoxes_);
+	mergedBoxes_ = ea::move(boxes);
+
+	//only worth it if it actually removes shapes.
+	if (mergedBoxes_.size() >= numSourceShapes_)
+	{
+		if (merged_)
+		{
+			SetSourcesEnabled(leftShapes, true);
+			for (auto& entry : pieceBoxes_)
+				SetSourcesEnabled(entry.second.shapes_, true);
+		}
+		RemoveMergedShapes();
+		merged_ = false;
+		return;
+	}
+
+	if (merged_)
+	{
+		SetSourcesEnabled(leftShapes, true);
+		SetSourcesEnabled(joinedShapes, false);
+	}
+	else
+	{
+		for (auto& entry : pieceBoxes_)
+			SetSourcesEnabled(entry.second.shapes_, false);
+	}
+
+	//merged shapes whose box did not change are kept - a piece joining or leaving only adds and removes the boxes around it.
+	ea::hash_map<unsigned, ea::vector<unsigned>> appliedIndices;
+	for (unsigned i = 0; i < mergedShapes_.size(); i++)
+		appliedIndices[HashBox(previousBoxes[i])].push_back(i);
+	ea::vector<bool> reused(mergedShapes_.size(), false);
+
+	ea::vector<WeakPtr<NewtonCollisionShape_Box>> mergedShapes;
+	for (const MergeBox& box : mergedBoxes_)
+	{
+		NewtonCollisionShape_Box* mergedShape = nullptr;
+
+		auto it = appliedIndices.find(HashBox(box));
+		if (it != appliedIndices.end())
+		{
+			for (unsigned i : it->second)
+			{
+				if (!reused[i] && mergedShapes_[i] && SameBox(previousBoxes[i], box))
+				{
+					reused[i] = true;
+					mergedShape = mergedShapes_[i];
+					break;
+				}
+			}
+		}
+
+		if (!mergedShape)
+		{
+			mergedShape = node_->CreateComponent<NewtonCollisionShape_Box>();
+			mergedShape->SetTemporary(true);
+			mergedShape->SetPositionOffset(box.rotation_ * ((box.min_ + box.max_) * 0.5f));
+			mergedShape->SetRotationOffset(box.rotation_);
+			mergedShape->SetScaleFactor(box.max_ - box.min_);
+		}
+		mergedShapes.push_back(WeakPtr<NewtonCollisionShape_Box>(mergedShape));
+	}
+
+	for (unsigned i = 0; i < mergedShapes_.size(); i++)
+	{
+		if (!reused[i] && mergedShapes_[i])
+			mergedShapes_[i]->Remove();
+	}
+	mergedShapes_ = ea::move(mergedShapes);
+
+	merged_ = true;
+}
+
+void PieceGroupMergedCollision::MarkPiecesChanged(Node* node)
+{
+	//a rescan is pending anyway.
+	if (rescan_)
+		return;
+
+	if (node->HasComponent<Piece>())
+		changedPieces_.insert(node->GetID());
+
+	ea::vector<Node*> pieceNodes;
+	node->GetChildrenWithComponent<Piece>(pieceNodes, true);
+	for (Node* pieceNode : pieceNodes)
+		changedPieces_.insert(pieceNode->GetID());
+}
+
+unsigned PieceGroupMergedCollision::HashBox(const MergeBox& box)
+{
+	unsigned hash = HashQuantized(0, box.min_);
+	return HashQuantized(hash, box.max_);
+}
+
+bool PieceGroupMergedCollision::SameBox(const MergeBox& a, const MergeBox& b)
+{
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		if (Quantize(GetAxis(a.min_, axis)) != Quantize(GetAxis(b.min_, axis)) || Quantize(GetAxis(a.max_, axis)) != Quantize(GetAxis(b.max_, axis)))
+			return false;
+	}
+	return Abs(a.rotation_.DotProduct(b.rotation_)) > 1.0f - MERGE_TOLERANCE * MERGE_TOLERANCE;
+}
+
+void PieceGroupMergedCollision::Revert()
+{
+	if (merged_)
+	{
+		for (auto& entry : pieceBoxes_)
+			SetSourcesEnabled(entry.second.shapes_, true);
+	}
+	sourceSet_.clear();
+	RemoveMergedShapes();
+	merged_ = false;
+}
+
+void PieceGroupMergedCollision::MergeBoxes(ea::vector<MergeBox>& boxes)
+{
+	//bucket by orientation.  boxes in a bucket are re-expressed in the bucket's rotation.
+	ea::vector<ea::vector<MergeBox>> buckets;
+	for (const MergeBox& box : boxes)
+	{
+		ea::vector<MergeBox>* bucket = nullptr;
+		for (ea::vector<MergeBox>& candidate : buckets)
+		{
+			if (Abs(candidate.front().rotation_.DotProduct(box.rotation_)) > 1.0f - MERGE_TOLERANCE * MERGE_TOLERANCE)
+			{
+				bucket = &candidate;
+				break;
+			}
+		}
+
+		if (!bucket)
+		{
+			buckets.emplace_back();
+			bucket = &buckets.back();
+			bucket->push_back(box);
+			continue;
+		}
+
+		MergeBox aligned;
+		aligned.rotation_ = bucket->front().rotation_;
+		Vector3 halfSize = (box.max_ - box.min_) * 0.5f;
+		Vector3 center = aligned.rotation_.Inverse() * (box.rotation_ * ((box.min_ + box.max_) * 0.5f));
+		aligned.min_ = center - halfSize;
+		aligned.max_ = center + halfSize;
+		aligned.sources_ = box.sources_;
+		bucket->push_back(aligned);
+	}
+
+	boxes.clear();
+	for (ea::vector<MergeBox>& bucket : buckets)
+	{
+		//fuse along each axis in turn until nothing changes - collinear runs first become beams, then beams with matching cross sections become slabs.
+		bool mergedAny = true;
+		while (mergedAny)
+		{
+			mergedAny = false;
+			for (unsigned axis = 0; axis < 3; axis++)
+			{
+				unsigned b = (axis + 1) % 3;
+				unsigned c = (axis + 2) % 3;
+
+				ea::sort(bucket.begin(), bucket.end(), [&](const MergeBox& l, const MergeBox& r) {
+					int lKey[4] = { Quantize(GetAxis(l.min_, b)), Quantize(GetAxis(l.max_, b)), Quantize(GetAxis(l.min_, c)), Quantize(GetAxis(l.max_, c)) };
+					int rKey[4] = { Quantize(GetAxis(r.min_, b)), Quantize(GetAxis(r.max_, b)), Quantize(GetAxis(r.min_, c)), Quantize(GetAxis(r.max_, c)) };
+					for (unsigned i = 0; i < 4; i++)
+					{
+						if (lKey[i] != rKey[i])
+							return lKey[i] < rKey[i];
+					}
+					return GetAxis(l.min_, axis) < GetAxis(r.min_, axis);
+				});
+
+				ea::vector<MergeBox> fused;
+				fused.reserve(bucket.size());
+				for (const MergeBox& box : bucket)
+				{
+					if (fused.size())
+					{
+						MergeBox& last = fused.back();
+						bool sameSection = Quantize(GetAxis(last.min_, b)) == Quantize(GetAxis(box.min_, b))
+							&& Quantize(GetAxis(last.max_, b)) == Quantize(GetAxis(box.max_, b))
+							&& Quantize(GetAxis(last.min_, c)) == Quantize(GetAxis(box.min_, c))
+							&& Quantize(GetAxis(last.max_, c)) == Quantize(GetAxis(box.max_, c));
+
+						//touching only - fusing overlapping boxes would count the shared volume once and change the group's mass and inertia.
+						if (sameSection && Abs(GetAxis(box.min_, axis) - GetAxis(last.max_, axis)) <= MERGE_TOLERANCE)
+						{
+							GetAxis(last.max_, axis) = GetAxis(box.max_, axis);
+							last.sources_.insert(last.sources_.end(), box.sources_.begin(), box.sources_.end());
+							mergedAny = true;
+							continue;
+						}
+					}
+					fused.push_back(box);
+				}
+				bucket = ea::move(fused);
+			}
+		}
+
+		boxes.insert(boxes.end(), bucket.begin(), bucket.end());
+	}
+}
+
+void PieceGroupMergedCollision::SetSourcesEnabled(const ea::vector<WeakPtr<NewtonCollisionShape_Box>>& shapes, bool enable)
+{
+	for (NewtonCollisionShape_Box* shape : shapes)
+	{
+		if (!shape)
+			continue;
+
+		if (!enable)
+		{
+			shape->SetEnabled(false);
+			sourceSet_.insert(shape);
+			continue;
+		}
+
+		sourceSet_.erase(shape);
+
+		//a merged group further up may have taken the shape over in the meantime.
+		bool claimed = false;
+		for (Node* node = shape->GetNode()->GetParent(); node && !claimed; node = node->GetParent())
+		{
+			PieceGroupMergedCollision* other = node->GetComponent<PieceGroupMergedCollision>();
+			claimed = other && other != this && other->merged_ && other->sourceSet_.contains(shape);
+		}
+
+		if (!claimed)
+			shape->SetEnabled(true);
+	}
+}
+
+void PieceGroupMergedCollision::RemoveMergedShapes()
+{
+	for (NewtonCollisionShape_Box* shape : mergedShapes_)
+	{
+		if (shape)
+			shape->Remove();
+	}
+	mergedShapes_.clear();
+}
+
+void PieceGroupMergedCollision::OnNodeSet(Node* node)
+{
+	if (!node)
+	{
+		//the merged shapes are on the node being left (and go with it) - only the piece shapes need to come back.
+		if (merged_)
+		{
+			for (auto& entry : pieceBoxes_)
+				SetSourcesEnabled(entry.second.shapes_, true);
+		}
+		sourceSet_.clear();
+		mergedShapes_.clear();
+		mergedBoxes_.clear();
+		pieceBoxes_.clear();
+		changedPieces_.clear();
+		numSourceShapes_ = 0;
+		merged_ = false;
+		rescan_ = true;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+class NewtonCollisionShape_Box;
+
+//collision merge for a solidified group.  fuses the box shapes of all pieces under the group node into fewer, larger boxes on the group node.
+//two boxes are fused when they share an orientation and their union is a box (same cross section, touching along the third axis).  overlapping boxes
+//are never fused, so the merged shapes have the same volume - and the group the same mass, centre of mass and inertia - as the piece shapes.
+//repeating that per axis turns rows of collinear beams into long boxes and coplanar rows into slabs.
+//the source shapes are disabled while merged and enabled again on Revert.  boxes are cached per piece and the merge is kept between rebuilds:
+//PieceManager reports pieces joining or leaving (MarkPiecesChanged) and Rebuild only redoes their boxes and the merged boxes they were part of.
+class PieceGroupMergedCollision : public Component
+{
+	URHO3D_OBJECT(PieceGroupMergedCollision, Component);
+
+public:
+
+	PieceGroupMergedCollision(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	///merge the piece shapes and swap them in.  only pieces marked changed since the last call are looked at again.
+	void Rebuild();
+
+	///enable the source shapes again and remove the merged ones.  the cached merge is kept.
+	void Revert();
+
+	///the pieces may move relative to the group from now on (it stopped being solid) - the next Rebuild recomputes every box.
+	void Invalidate() { rescan_ = true; }
+
+	///pieces at or under node joined or are leaving the group.
+	void MarkPiecesChanged(Node* node);
+
+	///true while merged shapes stand in for the piece shapes.
+	bool IsMerged() const { return merged_; }
+
+	unsigned GetNumSourceShapes() const { return numSourceShapes_; }
+	unsigned GetNumMergedShapes() const { return mergedShapes_.size(); }
+
+protected:
+
+	//box in the frame of its rotation (group node space).
+	struct MergeBox {
+		Quaternion rotation_;
+		Vector3 min_;
+		Vector3 max_;
+		ea::vector<ea::pair<unsigned, unsigned>> sources_;//piece node id and index into its PieceBoxes of every box fused into this one.
+	};
+
+	//boxes of one piece's shapes, in group node space.
+	struct PieceBoxes {
+		ea::vector<WeakPtr<NewtonCollisionShape_Box>> shapes_;
+		ea::vector<MergeBox> boxes_;
+	};
+
+	static void MergeBoxes(ea::vector<MergeBox>& boxes);
+
+	static unsigned HashBox(const MergeBox& box);
+	static bool SameBox(const MergeBox& a, const MergeBox& b);
+
+	void ComputePieceBoxes(Node* pieceNode, const Matrix3x4& groupInverse, PieceBoxes& pieceBoxes) const;
+
+	//enable or disable source shapes.  a shape that another merged group has claimed is left disabled.
+	void SetSourcesEnabled(const ea::vector<WeakPtr<NewtonCollisionShape_Box>>& shapes, bool enable);
+
+	void RemoveMergedShapes();
+
+	virtual void OnNodeSet(Node* node) override;
+
+	bool merged_ = false;
+	bool rescan_ = true;
+
+	ea::hash_map<unsigned, PieceBoxes> pieceBoxes_;//by piece node id.
+	ea::hash_set<unsigned> changedPieces_;//piece node ids that joined or left since the last Rebuild.
+	unsigned numSourceShapes_ = 0;
+
+	ea::vector<MergeBox> mergedBoxes_;//current merge, kept while reverted.
+	ea::vector<WeakPtr<NewtonCollisionShape_Box>> mergedShapes_;//shape of each merged box while merged.
+	ea::hash_set<NewtonCollisionShape_Box*> sourceSet_;//disabled source shapes.  lookup only - never dereferenced.
+};
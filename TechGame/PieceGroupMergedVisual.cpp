@@ -0,0 +1,325 @@
+#include "PieceGroupMergedVisual.h"
+#include "Piece.h"
+#include "PieceAimQuery.h"
+
+
+
+PieceGroupMergedVisual::PieceGroupMergedVisual(Context* context) : Component(context)
+{
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(PieceGroupMergedVisual, HandleUpdate));
+}
+
+PieceGroupMergedVisual::~PieceGroupMergedVisual()
+{
+	CancelMerge();
+}
+
+void PieceGroupMergedVisual::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PieceGroupMergedVisual>();
+}
+
+void PieceGroupMergedVisual::MergeWork(const WorkItem* item, unsigned threadIndex)
+{
+	MergeJob* job = reinterpret_cast<MergeJob*>(item->aux_);
+
+	for (const SourceGeometry& src : job->sources_)
+	{
+		ea::vector<float>& vertices = job->bucketVertices_[src.bucket_];
+		ea::vector<unsigned>& indices = job->bucketIndices_[src.bucket_];
+
+		unsigned base = vertices.size() / PIECE_MERGED_VERTEX_FLOATS;
+		Matrix3 normalMatrix = src.transform_.ToMatrix3().Inverse().Transpose();
+
+		for (unsigned v = src.vertexStart_; v < src.vertexStart_ + src.vertexCount_; v++)
+		{
+			const unsigned char* vertex = src.vertexData_ + v * src.vertexSize_;
+
+			Vector3 position = src.transform_ * *reinterpret_cast<const Vector3*>(vertex + src.positionOffset_);
+			Vector3 normal = Vector3::UP;
+			if (src.normalOffset_ != M_MAX_UNSIGNED)
+				normal = (normalMatrix * *reinterpret_cast<const Vector3*>(vertex + src.normalOffset_)).Normalized();
+			Vector2 texCoord = Vector2::ZERO;
+			if (src.texCoordOffset_ != M_MAX_UNSIGNED)
+				texCoord = *reinterpret_cast<const Vector2*>(vertex + src.texCoordOffset_);
+
+			vertices.push_back(position.x_);
+			vertices.push_back(position.y_);
+			vertices.push_back(position.z_);
+			vertices.push_back(normal.x_);
+			vertices.push_back(normal.y_);
+			vertices.push_back(normal.z_);
+			vertices.push_back(texCoord.x_);
+			vertices.push_back(texCoord.y_);
+
+			job->bounds_.Merge(position);
+		}
+
+		for (unsigned i = src.indexStart_; i < src.indexStart_ + src.indexCount_; i++)
+		{
+			unsigned index;
+			if (src.indexSize_ == sizeof(unsigned short))
+				index = reinterpret_cast<const unsigned short*>(src.indexData_)[i];
+			else
+				index = reinterpret_cast<const unsigned*>(src.indexData_)[i];
+
+			indices.push_back(base + index - src.vertexStart_);
+		}
+	}
+
+	job->done_.Set();
+}
+
+void PieceGroupMergedVisual::StartMerge()
+{
+	SharedPtr<MergeJob> job(new MergeJob());
+	ea::hash_map<ea::string, unsigned> bucketIndices;
+	unsigned signature = 0;
+
+	Matrix3x4 groupInverse = node_->GetWorldTransform().Inverse();
+
+	ea::vector<Node*> pieceNodes;
+	node_->GetChildrenWithComponent<Piece>(pieceNodes, true);
+	for (Node* pieceNode : pieceNodes)
+	{
+		Node* visualNode = pieceNode->GetComponent<Piece>()->GetVisualNode();
+		StaticModel* staticModel = visualNode ? visualNode->GetComponent<StaticModel>() : nullptr;
+		Model* model = staticModel ? staticModel->GetModel() : nullptr;
+		if (!model)
+			continue;
+
+		bool used = false;
+		for (unsigned g = 0; g < staticModel->GetNumGeometries(); g++)
+		{
+			Geometry* geometry = model->GetGeometry(g, 0);
+			Material* material = staticModel->GetMaterial(g);
+			if (!geometry || !material || geometry->GetPrimitiveType() != TRIANGLE_LIST)
+				continue;
+
+			VertexBuffer* vertexBuffer = geometry->GetVertexBuffer(0);
+			IndexBuffer* indexBuffer = geometry->GetIndexBuffer();
+			if (!vertexBuffer || !vertexBuffer->GetShadowData() || !indexBuffer || !indexBuffer->GetShadowData())
+				continue;
+
+			const VertexElement* positionElement = vertexBuffer->GetElement(SEM_POSITION);
+			if (!positionElement || positionElement->type_ != TYPE_VECTOR3)
+				continue;
+			const VertexElement* normalElement = vertexBuffer->GetElement(SEM_NORMAL);
+			const VertexElement* texCoordElement = vertexBuffer->GetElement(SEM_TEXCOORD);
+
+			//materials are unique per piece - bucket them by what they look like.
+			Technique* technique = material->GetTechnique(0);
+			Texture* texture = material->GetTexture(TU_DIFFUSE);
+			ea::string materialKey = (technique ? technique->GetName() : "") + "|" + (texture ? texture->GetName() : "")
+				+ "|" + material->GetShaderParameter("MatDiffColor").ToString();
+
+			unsigned bucket;
+			auto it = bucketIndices.find(materialKey);
+			if (it == bucketIndices.end())
+			{
+				bucket = job->bucketMaterials_.size();
+				bucketIndices.insert_or_assign(materialKey, bucket);
+				job->bucketMaterials_.push_back(material->Clone());
+			}
+			else
+				bucket = it->second;
+
+			SourceGeometry src;
+			src.vertexData_ = vertexBuffer->GetShadowData();
+			src.vertexSize_ = vertexBuffer->GetVertexSize();
+			src.vertexStart_ = geometry->GetVertexStart();
+			src.vertexCount_ = geometry->GetVertexCount();
+			src.positionOffset_ = positionElement->offset_;
+			if (normalElement && normalElement->type_ == TYPE_VECTOR3)
+				src.normalOffset_ = normalElement->offset_;
+			if (texCoordElement && texCoordElement->type_ == TYPE_VECTOR2)
+				src.texCoordOffset_ = texCoordElement->offset_;
+			src.indexData_ = indexBuffer->GetShadowData();
+			src.indexSize_ = indexBuffer->GetIndexSize();
+			src.indexStart_ = geometry->GetIndexStart();
+			src.indexCount_ = geometry->GetIndexCount();
+			src.transform_ = groupInverse * visualNode->GetWorldTransform();
+			src.bucket_ = bucket;
+			job->sources_.push_back(src);
+
+			signature = signature * 31 + pieceNode->GetID();
+			signature = signature * 31 + StringHash(materialKey).Value();
+			used = true;
+		}
+
+		if (used)
+		{
+			job->sourceModels_.push_back(SharedPtr<Model>(model));
+			job->hideModels_.push_back(WeakPtr<StaticModel>(staticModel));
+		}
+	}
+
+	if (signature == lastSignature_ && IsMerged())
+		return;
+	lastSignature_ = signature;
+
+	//pieces that left the group must show up right away - drop the stale merge instead of drawing them where they used to be.
+	ea::hash_set<StaticModel*> keptModels;
+	for (StaticModel* staticModel : job->hideModels_)
+		keptModels.insert(staticModel);
+
+	for (const HiddenModel& hidden : hiddenModels_)
+	{
+		if (hidden.model_ && !keptModels.contains(hidden.model_))
+		{
+			DropMerged();
+			break;
+		}
+	}
+
+	job->bucketVertices_.resize(job->bucketMaterials_.size());
+	job->bucketIndices_.resize(job->bucketMaterials_.size());
+
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	workItem_ = queue->GetFreeItem();
+	workItem_->workFunction_ = MergeWork;
+	workItem_->aux_ = job.Get();
+	workItem_->sendEvent_ = false;
+	job_ = job;
+
+	queue->AddWorkItem(workItem_);
+}
+
+void PieceGroupMergedVisual::FinishMerge()
+{
+	SharedPtr<MergeJob> job = job_;
+	job_ = nullptr;
+	workItem_ = nullptr;
+
+	DropMerged();
+
+	SharedPtr<Model> model(new Model(context_));
+	ea::vector<SharedPtr<VertexBuffer>> vertexBuffers;
+	ea::vector<SharedPtr<IndexBuffer>> indexBuffers;
+	ea::vector<SharedPtr<Material>> materials;
+
+	for (unsigned b = 0; b < job->bucketMaterials_.size(); b++)
+	{
+		if (job->bucketIndices_[b].empty())
+			continue;
+
+		SharedPtr<VertexBuffer> vertexBuffer(new VertexBuffer(context_));
+		vertexBuffer->SetShadowed(true);
+		vertexBuffer->SetSize(job->bucketVertices_[b].size() / PIECE_MERGED_VERTEX_FLOATS, MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1);
+		vertexBuffer->SetData(job->bucketVertices_[b].data());
+
+		SharedPtr<IndexBuffer> indexBuffer(new IndexBuffer(context_));
+		indexBuffer->SetShadowed(true);
+		indexBuffer->SetSize(job->bucketIndices_[b].size(), true);
+		indexBuffer->SetData(job->bucketIndices_[b].data());
+
+		SharedPtr<Geometry> geometry(new Geometry(context_));
+		geometry->SetVertexBuffer(0, vertexBuffer);
+		geometry->SetIndexBuffer(indexBuffer);
+		geometry->SetDrawRange(TRIANGLE_LIST, 0, job->bucketIndices_[b].size());
+
+		unsigned geometryIndex = vertexBuffers.size();
+		model->SetNumGeometries(geometryIndex + 1);
+		model->SetNumGeometryLodLevels(geometryIndex, 1);
+		model->SetGeometry(geometryIndex, 0, geometry);
+
+		vertexBuffers.push_back(vertexBuffer);
+		indexBuffers.push_back(indexBuffer);
+		materials.push_back(job->bucketMaterials_[b]);
+	}
+
+	numMergedGeometries_ = vertexBuffers.size();
+	if (!numMergedGeometries_)
+		return;
+
+	model->SetVertexBuffers(vertexBuffers, {}, {});
+	model->SetIndexBuffers(indexBuffers);
+	model->SetBoundingBox(job->bounds_);
+
+	//PieceManager leaves nodes without pieces out of its solidify rebuilds, so this child does not disturb the group.
+	mergedNode_ = node_->CreateChild("mergedVisual");
+	mergedNode_->SetTemporary(true);
+
+	StaticModel* mergedModel = mergedNode_->CreateComponent<StaticModel>();
+	mergedModel->SetModel(model);
+	for (unsigned i = 0; i < materials.size(); i++)
+		mergedModel->SetMaterial(i, materials[i]);
+	mergedModel->SetCastShadows(true);
+	mergedModel->SetViewMask(DEFAULT_VIEWMASK & ~PIECE_VIEWMASK_PICKABLE);
+
+	//sources keep only the pickable bit so aim raycasts still hit them but the camera skips them.
+	for (StaticModel* staticModel : job->hideModels_)
+	{
+		if (staticModel)
+		{
+			HiddenModel hidden;
+			hidden.model_ = staticModel;
+			hidden.viewMask_ = staticModel->GetViewMask();
+			hiddenModels_.push_back(hidden);
+		}
+	}
+	SetSourcesVisible(false);
+}
+
+void PieceGroupMergedVisual::SetSourcesVisible(bool visible)
+{
+	for (const HiddenModel& hidden : hiddenModels_)
+	{
+		if (hidden.model_)
+			hidden.model_->SetViewMask(visible ? hidden.viewMask_ : hidden.viewMask_ & PIECE_VIEWMASK_PICKABLE);
+	}
+}
+
+void PieceGroupMergedVisual::CancelMerge()
+{
+	if (!workItem_)
+		return;
+
+	//the job must not be freed while a worker is still reading from it.
+	if (!workItem_->completed_ && !GetSubsystem<WorkQueue>()->RemoveWorkItem(workItem_))
+		job_->done_.Wait();
+
+	workItem_ = nullptr;
+	job_ = nullptr;
+}
+
+void PieceGroupMergedVisual::DropMerged()
+{
+	SetSourcesVisible(true);
+	hiddenModels_.clear();
+
+	if (!mergedNode_.Expired())
+		mergedNode_->Remove();
+	numMergedGeometries_ = 0;
+}
+
+void PieceGroupMergedVisual::HandleUpdate(StringHash event, VariantMap& eventData)
+{
+	if (workItem_)
+	{
+		if (!workItem_->completed_)
+			return;
+
+		FinishMerge();
+	}
+
+	if (dirty_)
+	{
+		dirty_ = false;
+		StartMerge();
+	}
+}
+
+void PieceGroupMergedVisual::OnNodeSet(Node* node)
+{
+	if (node)
+	{
+		dirty_ = true;
+	}
+	else
+	{
+		CancelMerge();
+		DropMerged();
+		lastSignature_ = 0;
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+//floats per merged vertex: position(3) normal(3) texcoord(2)
+#define PIECE_MERGED_VERTEX_FLOATS 8
+
+
+class Piece;
+
+//render-merge for a solidified group.  bakes the visual models of all pieces under the group node into one Model with one geometry per material.
+//the merge runs on a worker thread and is redone only when the set of pieces or their materials changes.
+//the source models stay in the octree for aim raycasts but are hidden from the camera while the merged model is shown.
+class PieceGroupMergedVisual : public Component
+{
+	URHO3D_OBJECT(PieceGroupMergedVisual, Component);
+
+public:
+
+	PieceGroupMergedVisual(Context* context);
+	virtual ~PieceGroupMergedVisual();
+
+	static void RegisterObject(Context* context);
+
+	///request a re-merge.  cheap - nothing is rebuilt if pieces and materials are unchanged.
+	void MarkDirty() { dirty_ = true; }
+
+	///true once a merged model is showing.
+	bool IsMerged() const { return !mergedNode_.Expired(); }
+
+	unsigned GetNumMergedGeometries() const { return numMergedGeometries_; }
+
+	///give the hidden source models their own view masks back (before a scene save) or hide them again (after).
+	void SetSourcesVisible(bool visible);
+
+protected:
+
+	struct SourceGeometry {
+		const unsigned char* vertexData_ = nullptr;
+		unsigned vertexSize_ = 0;
+		unsigned vertexStart_ = 0;
+		unsigned vertexCount_ = 0;
+		unsigned positionOffset_ = M_MAX_UNSIGNED;
+		unsigned normalOffset_ = M_MAX_UNSIGNED;
+		unsigned texCoordOffset_ = M_MAX_UNSIGNED;
+
+		const unsigned char* indexData_ = nullptr;
+		unsigned indexSize_ = 0;
+		unsigned indexStart_ = 0;
+		unsigned indexCount_ = 0;
+
+		Matrix3x4 transform_;//piece visual space -> group node space
+		unsigned bucket_ = 0;
+	};
+
+	//everything the worker thread touches.  source models are held so their shadow data outlives the job.
+	struct MergeJob : public RefCounted {
+		ea::vector<SharedPtr<Model>> sourceModels_;
+		ea::vector<SourceGeometry> sources_;
+
+		ea::vector<SharedPtr<Material>> bucketMaterials_;
+		ea::vector<ea::vector<float>> bucketVertices_;
+		ea::vector<ea::vector<unsigned>> bucketIndices_;
+		BoundingBox bounds_;
+
+		ea::vector<WeakPtr<StaticModel>> hideModels_;
+
+		Condition done_;//set by the worker when it no longer touches the job.
+	};
+
+	//a source model hidden by the merge and the view mask it had before.
+	struct HiddenModel {
+		WeakPtr<StaticModel> model_;
+		unsigned viewMask_ = DEFAULT_VIEWMASK;
+	};
+
+	static void MergeWork(const WorkItem* item, unsigned threadIndex);
+
+	void StartMerge();
+
+	void FinishMerge();
+
+	void CancelMerge();
+
+	//show the source models again and remove the merged model.
+	void DropMerged();
+
+	void HandleUpdate(StringHash event, VariantMap& eventData);
+
+	virtual void OnNodeSet(Node* node) override;
+
+	bool dirty_ = true;
+	unsigned lastSignature_ = 0;
+
+	SharedPtr<MergeJob> job_;
+	SharedPtr<WorkItem> workItem_;
+
+	WeakPtr<Node> mergedNode_;
+	unsigned numMergedGeometries_ = 0;
+	ea::vector<HiddenModel> hiddenModels_;
+};
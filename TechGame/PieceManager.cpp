@@ -2,6 +2,16 @@
 #include "Piece.h"
 #include "PiecePoint.h"
 #include "PiecePointRow.h"
+#include "PieceAimQuery.h"
+#include "PiecePointIndicatorRenderer.h"
+#include "PieceUndoJournal.h"
+#include "PieceGear.h"
+
+#include "PieceGroupMergedCollision.h"
+#include "PieceGroupMergedVisual.h"
+
+#include "NewtonPhysicsWorld.h"
+#include "NewtonCollisionShapesDerived.h"
 
 
 #include "EASTL/sort.h"
@@ -41,6 +51,79 @@ void PieceManager::UnPackAssembly(Node* assemblyRoot, ea::vector<Node*>& pieceNo
 	}
 }
 
+void PieceManager::ApplyAttributes()
+{
+	ResolveLoadedReferences();
+}
+
+void PieceManager::ResolveLoadedReferences()
+{
+	//one id table for the scene instead of a lookup and cast per saved reference.
+	ea::hash_map<unsigned, PiecePoint*> pointsById;
+	ea::hash_map<unsigned, PiecePointRow*> rowsById;
+	pointsById.reserve(pointRegistry_.Size());
+	rowsById.reserve(rowRegistry_.Size());
+
+	for (PiecePoint* point : pointRegistry_.GetAll())
+		pointsById.insert_or_assign(point->GetID(), point);
+	for (PiecePointRow* row : rowRegistry_.GetAll())
+		rowsById.insert_or_assign(row->GetID(), row);
+
+	auto findPoint = [&pointsById](unsigned id) -> PiecePoint* {
+		auto it = pointsById.find(id);
+		return it != pointsById.end() ? it->second : nullptr;
+	};
+	auto findRow = [&rowsById](unsigned id) -> PiecePointRow* {
+		auto it = rowsById.find(id);
+		return it != rowsById.end() ? it->second : nullptr;
+	};
+
+
+	unsigned numResolved = 0;
+	for (PiecePoint* point : pointRegistry_.GetAll())
+	{
+		if (point->rowId_ && !point->row_)
+		{
+			point->row_ = findRow(point->rowId_);
+			numResolved++;
+		}
+	}
+
+	for (PiecePointRow* row : rowRegistry_.GetAll())
+	{
+		if (row->pointIds_.size())
+		{
+			for (unsigned id : row->pointIds_)
+			{
+				if (PiecePoint* point = findPoint(id))
+					row->points_.push_back(SharedPtr<PiecePoint>(point));
+			}
+			numResolved += row->pointIds_.size();
+			row->pointIds_.clear();
+		}
+
+		for (PiecePointRow::RowAttachement& att : row->rowAttachements_)
+		{
+			if (!att.rowId_ || att.row_)
+				continue;
+
+			//constraints are not registered - the scene id lookup is a single hash find.
+			Component* constraint = GetScene()->GetComponent(att.constraintId_);
+			if (constraint && constraint->IsInstanceOf<NewtonConstraint>())
+				att.constraint_ = static_cast<NewtonConstraint*>(constraint);
+
+			att.point = findPoint(att.pointId);
+			att.pointOther_ = findPoint(att.pointOtherId_);
+			att.row_ = findRow(att.rowId_);
+			att.rowOther_ = findRow(att.rowOtherId_);
+			numResolved++;
+		}
+	}
+
+	if (numResolved)
+		URHO3D_LOGINFO("PieceManager: resolved " + ea::to_string(numResolved) + " loaded piece references");
+}
+
 void PieceManager::GetAllPointsInContraption(Piece* pieceInContraption, ea::vector<PiecePoint*>& points)
 {
 	ea::vector<Piece*> pieces;
@@ -174,35 +257,49 @@ void PieceManager::GetPointsInRadius(ea::vector<PiecePoint*>& points, Vector3 wo
 }
 
 
-Piece* PieceManager::GetClosestAimPiece(Vector3& worldPos, Node* lookNode)
+PieceAimQuery* PieceManager::GetAimQuery(Node* lookNode)
 {
+	//one cached query per look node - repeated calls in the same frame do not raycast again.
+	PieceAimQuery* aimQuery = lookNode->GetComponent<PieceAimQuery>();
+	if (!aimQuery) {
+		aimQuery = lookNode->CreateComponent<PieceAimQuery>();
+		aimQuery->SetTemporary(true);
+	}
+	return aimQuery;
+}
 
-	//Camera* camera = node_->GetComponent<Camera>();
-	Node* node = lookNode;
-
-	Octree* octree = GetScene()->GetComponent<Octree>();
-	RayOctreeQuery querry(Ray(node->GetWorldPosition(), node->GetWorldDirection()));
+Piece* PieceManager::GetClosestAimPiece(Vector3& worldPos, Node* lookNode)
+{
+	return GetAimQuery(lookNode)->GetAimPiece(worldPos);
+}
 
-	GetSubsystem<VisualDebugger>()->AddLine(node->GetWorldPosition(), node->GetWorldPosition() + node->GetWorldDirection()* 10.0f, Color::GREEN, false);
 
-	octree->Raycast(querry);
 
-	if (querry.result_.size() > 1)
+PiecePointIndicatorRenderer* PieceManager::GetPointIndicatorRenderer()
+{
+	if (pointIndicatorRenderer_.Expired() && GetScene())
 	{
-		if (querry.result_[1].node_->GetName() == "visualNode")
-		{
-			Piece* piece = querry.result_[1].node_->GetParent()->GetComponent<Piece>();
-			if (piece) {
-				worldPos = querry.result_[1].position_;
-				return piece;
-			}
+		pointIndicatorRenderer_ = GetScene()->GetComponent<PiecePointIndicatorRenderer>();
+		if (pointIndicatorRenderer_.Expired()) {
+			pointIndicatorRenderer_ = GetScene()->CreateComponent<PiecePointIndicatorRenderer>();
+			pointIndicatorRenderer_->SetTemporary(true);
 		}
 	}
-
-	return nullptr;
+	return pointIndicatorRenderer_;
 }
 
-
+PieceUndoJournal* PieceManager::GetUndoJournal()
+{
+	if (undoJournal_.Expired())
+	{
+		undoJournal_ = GetScene()->GetComponent<PieceUndoJournal>();
+		if (undoJournal_.Expired()) {
+			undoJournal_ = GetScene()->CreateComponent<PieceUndoJournal>();
+			undoJournal_->SetTemporary(true);
+		}
+	}
+	return undoJournal_;
+}
 
 PiecePoint* PieceManager::GetClosestAimPiecePoint(Node* lookNode)
 {
@@ -254,7 +351,7 @@ Urho3D::Node* PieceManager::CreateGroupNode(Node* parent, Vector3 worldPosition)
 	node->SetWorldPosition(worldPosition);
 	node->CreateComponent<PieceSolidificationGroup>();
 
-	RebuildSolidifies();
+	RebuildSolidifiesBranches({ node });
 	return node;
 }
 
@@ -263,21 +360,36 @@ Urho3D::Node* PieceManager::CreateGroupNode(Node* parent, Vector3 worldPosition)
 //moves piece to the specified group - potentially removing it from it's existing group.
 void PieceManager::MovePieceToSolidGroup(Piece* piece, PieceSolidificationGroup* group, bool clean/* = true*/)
 {
-	RemovePieceFromGroup(piece, clean);
-	
-	piece->GetNode()->SetParent(group->GetNode());
-
-	RebuildSolidifies();
+	ea::vector<Piece*> pieces = { piece };
+	MovePiecesToSolidGroup(pieces, group, clean);
 }
 
 
 
 void PieceManager::MovePiecesToSolidGroup(ea::vector<Piece*>& pieces, PieceSolidificationGroup* group, bool clean /*= true*/)
 {
+	//reparent everything first, then resolve only the branches that were touched - once.
+	Node* groupNode = group->GetNode();
+	ea::vector<WeakPtr<Node>> oldParents;
+	SuspendNodeRebuilds();
 	for (Piece* pc : pieces)
 	{
-		MovePieceToSolidGroup(pc, group, clean);
+		Node* oldParent = pc->GetNode()->GetParent();
+		pc->GetNode()->SetParent(groupNode);
+		oldParents.push_back(WeakPtr<Node>(oldParent));
+
+		if (clean && oldParent != groupNode && !groupNode->IsChildOf(oldParent))
+			CleanGroups(oldParent);
+	}
+	ResumeNodeRebuilds();
+
+	ea::vector<Node*> changedNodes = { groupNode };
+	for (Node* oldParent : oldParents)
+	{
+		if (oldParent)
+			changedNodes.push_back(oldParent);
 	}
+	RebuildSolidifiesBranches(changedNodes);
 }
 
 PieceSolidificationGroup* PieceManager::GetCommonSolidGroup(ea::vector<Piece*> pieces)
@@ -300,27 +412,36 @@ PieceSolidificationGroup* PieceManager::GetCommonSolidGroup(ea::vector<Piece*> p
 
 void PieceManager::RemovePieceFromGroup(Piece* piece, bool postClean /*= true*/)
 {
-	Node* oldParent = piece->GetNode()->GetParent();
-	piece->GetNode()->SetParent(GetScene());
-
-	if (postClean)
-	{
-		CleanGroups(oldParent);
-	}
-
-	RebuildSolidifies();
+	RemovePiecesFromGroups({ piece }, postClean);
 }
 
 
 void PieceManager::RemovePiecesFromGroups(const ea::vector<Piece*>& pieces, bool postClean /*= true*/)
 {
-
+	ea::vector<WeakPtr<Node>> oldParents;
+	SuspendNodeRebuilds();
 	for (Piece* pc : pieces)
 	{
-		RemovePieceFromGroup(pc, postClean);
+		Node* oldParent = pc->GetNode()->GetParent();
+		pc->GetNode()->SetParent(GetScene());
+		oldParents.push_back(WeakPtr<Node>(oldParent));
+
+		if (postClean)
+		{
+			CleanGroups(oldParent);
+		}
 	}
+	ResumeNodeRebuilds();
 
-	RebuildSolidifies();
+	ea::vector<Node*> changedNodes;
+	for (Piece* pc : pieces)
+		changedNodes.push_back(pc->GetNode());
+	for (Node* oldParent : oldParents)
+	{
+		if (oldParent)
+			changedNodes.push_back(oldParent);
+	}
+	RebuildSolidifiesBranches(changedNodes);
 }
 
 
@@ -336,14 +457,16 @@ void PieceManager::RemoveSolidGroup(PieceSolidificationGroup* group)
 	group->GetNode()->GetChildren(children);
 
 	Node* parent = group->GetNode()->GetParent();
+	SuspendNodeRebuilds();
 	for (Node* node : children)
 	{
 		node->SetParent(parent);
 	}
 
 	group->GetNode()->Remove();
+	ResumeNodeRebuilds();
 
-	RebuildSolidifies();
+	RebuildSolidifiesBranches(children);
 }
 
 void PieceManager::RebuildSolidifiesSub(Node* startNode, bool branchSolidified)
@@ -351,15 +474,40 @@ void PieceManager::RebuildSolidifiesSub(Node* startNode, bool branchSolidified)
 
 	if (startNode->HasComponent<PieceSolidificationGroup>()) 
 	{
-		if (!branchSolidified && startNode->GetComponent<PieceSolidificationGroup>()->GetSolidified())
+		PieceSolidificationGroup* group = startNode->GetComponent<PieceSolidificationGroup>();
+		//group bodies are kept and only switched on and off - see CaptureBodyMotion.
+		NewtonRigidBody* body = startNode->GetComponent<NewtonRigidBody>();
+		if (!branchSolidified && group->GetSolidified())
 		{
 			branchSolidified = true;
-			NewtonRigidBody* body = startNode->GetOrCreateComponent<NewtonRigidBody>();
-			body->SetEnabled(true);
+			if (!body || !body->IsEnabled())
+			{
+				if (!body)
+					body = startNode->CreateComponent<NewtonRigidBody>();
+
+				//same state as a freshly created body.
+				body->SetMassScale(1.0f);
+				body->SetIsKinematic(false);
+				body->SetNoCollideOverride(false);
+				body->SetEnabled(true);
+				body->SetTemporary(false);
+				activatedBodies_.push_back(WeakPtr<NewtonRigidBody>(body));
+			}
+
+			group->SetRenderMerged(renderMergeSolidGroups_);
+			group->SetCollisionMerged(mergeSolidGroupCollision_);
 		}
 		else
 		{
-			startNode->RemoveComponent<NewtonRigidBody>();
+			//a switched off body is only kept for reuse this session - scene saves leave it out.
+			if (body)
+			{
+				body->SetEnabled(false);
+				body->SetTemporary(true);
+			}
+
+			group->SetRenderMerged(false);
+			group->SetCollisionMerged(false);
 		}
 	}
 
@@ -370,9 +518,17 @@ void PieceManager::RebuildSolidifiesSub(Node* startNode, bool branchSolidified)
 	{
 		if (child->GetComponent<Piece>()) {
 
-			child->GetComponent<NewtonRigidBody>()->SetEnabled(!branchSolidified);
-			if (child->GetComponent<NewtonRigidBody>()->GetMassScale() <= 0.0f)
-				startNode->GetComponent<NewtonRigidBody>()->SetMassScale(0.0f);
+			NewtonRigidBody* pieceBody = child->GetComponent<NewtonRigidBody>();
+			if (pieceBody->IsEnabled() == branchSolidified)
+			{
+				pieceBody->SetEnabled(!branchSolidified);
+				if (!branchSolidified)
+					activatedBodies_.push_back(WeakPtr<NewtonRigidBody>(pieceBody));
+			}
+
+			NewtonRigidBody* groupBody = startNode->GetComponent<NewtonRigidBody>();
+			if (pieceBody->GetMassScale() <= 0.0f && groupBody)
+				groupBody->SetMassScale(0.0f);
 		}
 		else
 		{
@@ -383,35 +539,323 @@ void PieceManager::RebuildSolidifiesSub(Node* startNode, bool branchSolidified)
 
 void PieceManager::RebuildSolidifies()
 {
-	RebuildSolidifiesSub(GetScene(), false);
+	groupVersion_++;
+
+	//only bodies in branches with a group can be switched - loose pieces keep theirs, so their motion is not captured.
+	Scene* scene = GetScene();
+	ea::hash_set<Node*> branches;
+	for (PieceSolidificationGroup* group : groupRegistry_.GetAll())
+	{
+		Node* node = group->GetNode();
+		while (node->GetParent() && node->GetParent() != scene)
+			node = node->GetParent();
+		branches.insert(node);
+	}
+
+	ea::hash_map<Piece*, BodyMotion> motion;
+	for (Node* branch : branches)
+		CaptureBodyMotion(branch, motion);
+
+	activatedBodies_.clear();
+	RebuildSolidifiesSub(scene, false);
+	ApplyBodyMotion(motion);
+}
+
+void PieceManager::BeginSceneSave()
+{
+	//held bodies are kinematic and still - save them as they really move.
+	PromoteAllContraptions();
+
+	savedCollisionMerges_.clear();
+	savedVisualMerges_.clear();
+	for (PieceSolidificationGroup* group : groupRegistry_.GetAll())
+	{
+		PieceGroupMergedCollision* mergedCollision = group->GetNode()->GetComponent<PieceGroupMergedCollision>();
+		if (mergedCollision && mergedCollision->IsMerged())
+		{
+			mergedCollision->Revert();
+			savedCollisionMerges_.push_back(WeakPtr<PieceGroupMergedCollision>(mergedCollision));
+		}
+
+		PieceGroupMergedVisual* mergedVisual = group->GetNode()->GetComponent<PieceGroupMergedVisual>();
+		if (mergedVisual && mergedVisual->IsMerged())
+		{
+			mergedVisual->SetSourcesVisible(true);
+			savedVisualMerges_.push_back(WeakPtr<PieceGroupMergedVisual>(mergedVisual));
+		}
+	}
+}
+
+void PieceManager::EndSceneSave()
+{
+	//same pieces as before the save - the cached merge is reused.
+	for (PieceGroupMergedCollision* mergedCollision : savedCollisionMerges_)
+	{
+		if (mergedCollision)
+			mergedCollision->Rebuild();
+	}
+	savedCollisionMerges_.clear();
+
+	for (PieceGroupMergedVisual* mergedVisual : savedVisualMerges_)
+	{
+		if (mergedVisual)
+			mergedVisual->SetSourcesVisible(false);
+	}
+	savedVisualMerges_.clear();
+}
+
+void PieceManager::SetupAfterSceneLoad()
+{
+	//only a collision merge disables piece shapes, and the merge itself is never saved.
+	for (Piece* piece : pieceRegistry_.GetAll())
+	{
+		ea::vector<NewtonCollisionShape_Box*> shapes;
+		piece->GetNode()->GetComponents<NewtonCollisionShape_Box>(shapes);
+		for (NewtonCollisionShape_Box* shape : shapes)
+			shape->SetEnabled(true);
+	}
+
+	RebuildSolidifies();
+	RestoreLodContraptions();
+}
+
+void PieceManager::RebuildSolidifiesBranches(const ea::vector<Node*>& nodes)
+{
+	groupVersion_++;
+
+	Scene* scene = GetScene();
+
+	//solid state only depends on ancestors, so the scene child above a node is enough.
+	ea::vector<Node*> branches;
+	for (Node* node : nodes)
+	{
+		if (!node || node == scene || node->GetScene() != scene)
+			continue;
+
+		while (node->GetParent() != scene)
+			node = node->GetParent();
+
+		if (!branches.contains(node))
+			branches.push_back(node);
+	}
+
+	ea::hash_map<Piece*, BodyMotion> motion;
+	for (Node* branch : branches)
+		CaptureBodyMotion(branch, motion);
+
+	activatedBodies_.clear();
+	for (Node* branch : branches)
+	{
+		//a loose piece - same as the scene level of RebuildSolidifiesSub.
+		NewtonRigidBody* pieceBody = branch->GetComponent<Piece>() ? branch->GetComponent<NewtonRigidBody>() : nullptr;
+		if (pieceBody)
+		{
+			if (!pieceBody->IsEnabled())
+			{
+				pieceBody->SetEnabled(true);
+				activatedBodies_.push_back(WeakPtr<NewtonRigidBody>(pieceBody));
+			}
+		}
+		else
+			RebuildSolidifiesSub(branch, false);
+	}
+	ApplyBodyMotion(motion);
+}
+
+NewtonRigidBody* PieceManager::GetActiveBody(Piece* piece)
+{
+	Node* node = piece->GetNode();
+	Scene* scene = node->GetScene();
+	while (node && node != scene)
+	{
+		NewtonRigidBody* body = node->GetComponent<NewtonRigidBody>();
+		if (body && body->IsEnabled())
+			return body;
+		node = node->GetParent();
+	}
+	return nullptr;
+}
+
+void PieceManager::CaptureBodyMotion(Node* branch, ea::hash_map<Piece*, BodyMotion>& motion)
+{
+	ea::vector<Node*> pieceNodes;
+	branch->GetChildrenWithComponent<Piece>(pieceNodes, true);
+	if (branch->GetComponent<Piece>())
+		pieceNodes.push_back(branch);
+
+	//group bodies report the velocity of their centre of mass - estimate it from the pieces they carry.
+	ea::hash_map<NewtonRigidBody*, Vector4> centers;
+	for (Node* pieceNode : pieceNodes)
+	{
+		NewtonRigidBody* body = GetActiveBody(pieceNode->GetComponent<Piece>());
+		if (body && body->GetNode() != pieceNode)
+		{
+			float weight = Max(pieceNode->GetComponent<NewtonRigidBody>()->GetMassScale(), M_EPSILON);
+			centers[body] += Vector4(pieceNode->GetWorldPosition() * weight, weight);
+		}
+	}
+
+	for (Node* pieceNode : pieceNodes)
+	{
+		Piece* piece = pieceNode->GetComponent<Piece>();
+		NewtonRigidBody* body = GetActiveBody(piece);
+		if (!body)
+			continue;
+
+		BodyMotion& pieceMotion = motion[piece];
+		pieceMotion.linear_ = body->GetLinearVelocity(TS_WORLD);
+		pieceMotion.angular_ = body->GetAngularVelocity(TS_WORLD);
+
+		if (body->GetNode() != pieceNode)
+		{
+			const Vector4& center = centers[body];
+			Vector3 centerOfMass = Vector3(center.x_, center.y_, center.z_) / center.w_;
+			pieceMotion.linear_ += pieceMotion.angular_.CrossProduct(pieceNode->GetWorldPosition() - centerOfMass);
+		}
+	}
+}
+
+void PieceManager::ApplyBodyMotion(const ea::hash_map<Piece*, BodyMotion>& motion)
+{
+	for (NewtonRigidBody* body : activatedBodies_)
+	{
+		if (!body || body->GetMassScale() <= 0.0f)
+			continue;
+
+		ea::vector<Node*> pieceNodes;
+		body->GetNode()->GetChildrenWithComponent<Piece>(pieceNodes, true);
+		if (body->GetNode()->GetComponent<Piece>())
+			pieceNodes.push_back(body->GetNode());
+
+		//a piece body takes its own motion, a group body the average of the pieces it now carries.
+		Vector3 linear;
+		Vector3 angular;
+		float totalWeight = 0.0f;
+		for (Node* pieceNode : pieceNodes)
+		{
+			auto it = motion.find(pieceNode->GetComponent<Piece>());
+			if (it == motion.end())
+				continue;
+
+			float weight = Max(pieceNode->GetComponent<NewtonRigidBody>()->GetMassScale(), M_EPSILON);
+			linear += it->second.linear_ * weight;
+			angular += it->second.angular_ * weight;
+			totalWeight += weight;
+		}
+
+		if (totalWeight <= 0.0f)
+			continue;
+
+		body->SetLinearVelocity(linear / totalWeight, false);
+		body->SetAngularVelocity(angular / totalWeight);
+	}
+	activatedBodies_.clear();
 }
 
 void PieceManager::CleanGroups(Node* node)
 {
 	Node* curNode = node;
 	
+	//only groups without pieces go - nothing's solid state changes.
 	int numPieceChildren = curNode->GetChildrenWithComponent(Piece::GetTypeStatic(), false).size();
+	SuspendNodeRebuilds();
 	while (curNode && !numPieceChildren && curNode != GetScene()) {
 		Node* rem = curNode;
 		curNode = curNode->GetParent();
 		rem->Remove();
 	}
+	ResumeNodeRebuilds();
 }
 
 void PieceManager::CleanAll()
 {
-	ea::vector<Node*> allChildren;
-	GetScene()->GetChildrenWithComponent<PieceSolidificationGroup>(allChildren, true);
+	//CleanGroups removes nodes as it goes so work from weak refs of a snapshot.
+	ea::vector<WeakPtr<Node>> allChildren;
+	for (PieceSolidificationGroup* group : groupRegistry_.GetAll())
+		allChildren.push_back(WeakPtr<Node>(group->GetNode()));
 
 
 	for (Node* node : allChildren)
 	{
-		CleanGroups(node);//kind-of redundant code here.
+		if (node)
+			CleanGroups(node);//kind-of redundant code here.
 	}
 
 }
 
 
+void PieceManager::UpdateContraptionIds()
+{
+	if (!contraptionIdsDirty_)
+		return;
+	contraptionIdsDirty_ = false;
+
+	for (Piece* piece : pieceRegistry_.GetAll())
+		piece->contraptionId_ = 0;
+	numContraptions_ = 0;
+
+	//flood fill over row attachments and assemblies - every piece and attachment is visited once.
+	ea::vector<Piece*> stack;
+	ea::vector<PiecePointRow*> rows;
+	ea::vector<Piece*> assemblyPieces;
+	for (Piece* start : pieceRegistry_.GetAll())
+	{
+		if (start->contraptionId_)
+			continue;
+
+		unsigned id = ++numContraptions_;
+		start->contraptionId_ = id;
+		stack.push_back(start);
+
+		while (stack.size())
+		{
+			Piece* piece = stack.back();
+			stack.pop_back();
+
+			rows.clear();
+			piece->GetPointRows(rows);
+			for (PiecePointRow* row : rows)
+			{
+				for (PiecePointRow::RowAttachement& attachment : row->rowAttachements_)
+				{
+					Piece* other = attachment.rowOther_ ? attachment.rowOther_->GetPiece() : nullptr;
+					if (other && !other->contraptionId_)
+					{
+						other->contraptionId_ = id;
+						stack.push_back(other);
+					}
+				}
+			}
+
+			piece->GetAssemblyPieces(assemblyPieces, false);
+			for (Piece* other : assemblyPieces)
+			{
+				if (!other->contraptionId_)
+				{
+					other->contraptionId_ = id;
+					stack.push_back(other);
+				}
+			}
+		}
+	}
+}
+
+unsigned PieceManager::GetContraptionId(Piece* piece)
+{
+	UpdateContraptionIds();
+	return piece->contraptionId_;
+}
+
+void PieceManager::GetContraptions(ea::vector<ea::vector<Piece*>>& contraptions)
+{
+	UpdateContraptionIds();
+
+	contraptions.clear();
+	contraptions.resize(numContraptions_);
+	for (Piece* piece : pieceRegistry_.GetAll())
+		contraptions[piece->contraptionId_ - 1].push_back(piece);
+}
+
 void PieceManager::GetRigidlyConnectedPieces(Piece* startingPiece, ea::vector<Piece*>& pieces)
 {
 	if (!pieces.contains(startingPiece))
@@ -482,8 +926,8 @@ void PieceManager::FormSolidGroupsOnContraption(Piece* startingPiece)
 
 void PieceManager::ClearAllGroups()
 {
-	ea::vector<PieceSolidificationGroup*> groups;
-	GetScene()->GetComponents<PieceSolidificationGroup>(groups, true);
+	//copy - removing groups modifies the registry.
+	ea::vector<PieceSolidificationGroup*> groups = groupRegistry_.GetAll();
 	for (auto* gp : groups) {
 		RemoveSolidGroup(gp);
 	}
@@ -496,8 +940,7 @@ void PieceManager::AutoFormAllGroups()
 {
 	ClearAllGroups();
 
-	ea::vector<Piece*> allPieces;
-	GetScene()->GetComponents<Piece>(allPieces, true);
+	ea::vector<Piece*> allPieces = pieceRegistry_.GetAll();
 	for (Piece* pc : allPieces) {
 		FormSolidGroup(pc);
 	}
@@ -576,17 +1019,28 @@ void PieceManager::FindLoops(Piece* piece, ea::vector<ea::vector<Piece*>>& loops
 }
 
 
+//true if node or anything under it is a piece or group.  other children of a group (merged visuals, freshly created empty nodes) never change solid state.
+static bool HoldsPieces(Node* node)
+{
+	if (node->HasComponent<Piece>() || node->HasComponent<PieceSolidificationGroup>())
+		return true;
+
+	for (Node* child : node->GetChildren())
+	{
+		if (HoldsPieces(child))
+			return true;
+	}
+	return false;
+}
+
 void PieceManager::HandleNodeAdded(StringHash event, VariantMap& eventData)
 {
 	Node* node = (Node*)eventData[NodeAdded::P_NODE].GetPtr();
 	Node* parentNode = (Node*)eventData[NodeAdded::P_PARENT].GetPtr();
 	Scene* scene = (Scene*)eventData[NodeAdded::P_SCENE].GetPtr();
 
-	if (scene == GetScene() && parentNode->HasComponent<PieceSolidificationGroup>())
-	{
-		RebuildSolidifies();
-	}
-
+	if (scene == GetScene() && parentNode->HasComponent<PieceSolidificationGroup>() && HoldsPieces(node))
+		HandleGroupMembershipChange(node, parentNode);
 }
 
 void PieceManager::HandleNodeRemoved(StringHash event, VariantMap& eventData)
@@ -595,9 +1049,91 @@ void PieceManager::HandleNodeRemoved(StringHash event, VariantMap& eventData)
 	Node* parentNode = (Node*)eventData[NodeRemoved::P_PARENT].GetPtr();
 	Scene* scene = (Scene*)eventData[NodeRemoved::P_SCENE].GetPtr();
 
-	if (scene == GetScene() && parentNode->HasComponent<PieceSolidificationGroup>())
+	if (scene == GetScene() && parentNode->HasComponent<PieceSolidificationGroup>() && HoldsPieces(node))
+		HandleGroupMembershipChange(node, parentNode);
+}
+
+void PieceManager::HandleGroupMembershipChange(Node* node, Node* parentNode)
+{
+	//merged collisions above track their pieces even while rebuilds are suspended - the rebuild that follows only redoes these.
+	for (Node* curNode = parentNode; curNode; curNode = curNode->GetParent())
 	{
-		RebuildSolidifies();
+		if (PieceGroupMergedCollision* mergedCollision = curNode->GetComponent<PieceGroupMergedCollision>())
+			mergedCollision->MarkPiecesChanged(node);
 	}
+
+	if (!nodeRebuildsSuspended_)
+		RebuildSolidifiesBranches({ parentNode });
 }
 
+void PieceManager::TickPieceSystems()
+{
+	HiresTimer timer;
+
+	//by index - a tick can detach rows but never adds or removes them.
+	const ea::vector<PiecePointRow*>& rows = rowRegistry_.GetAll();
+	for (unsigned i = 0; i < rows.size(); i++)
+		rows[i]->Tick();
+
+	const ea::vector<PieceGear*>& gears = gearRegistry_.GetAll();
+	for (unsigned i = 0; i < gears.size(); i++)
+		gears[i]->Tick();
+
+	pieceTickHistogram_.Add(timer.GetUSec(false));
+}
+
+void PieceManager::HandleUpdate(StringHash event, VariantMap& eventData)
+{
+	using namespace Update;
+
+	if (!fixedStepUpdates_)
+		TickPieceSystems();
+
+	//group formation results are applied here, at the frame boundary.
+	if (groupFormationItem_ && groupFormationItem_->completed_)
+		FinishGroupFormation();
+	if (groupFormationRequested_ && !groupFormationItem_)
+		StartGroupFormation();
+
+	if (lodEnabled_)
+	{
+		lodTimer_ += eventData[P_TIMESTEP].GetFloat();
+		if (lodTimer_ >= lodUpdateInterval_)
+		{
+			UpdateLod(lodTimer_);
+			lodTimer_ = 0.0f;
+		}
+	}
+
+	if (rateSchedulingEnabled_)
+	{
+		rateTimer_ += eventData[P_TIMESTEP].GetFloat();
+		if (rateTimer_ >= rateUpdateInterval_)
+		{
+			UpdateRateSchedule();
+			rateTimer_ = 0.0f;
+		}
+	}
+}
+
+void PieceManager::HandlePhysicsPreStep(StringHash event, VariantMap& eventData)
+{
+	if (GetEventSender() != GetScene()->GetComponent<NewtonPhysicsWorld>())
+		return;
+
+	physicsStepTimer_.Reset();
+
+	if (rateSchedulingEnabled_)
+		StepRateSchedule(eventData[NewtonPhysicsPreStep::P_TIMESTEP].GetFloat());
+}
+
+void PieceManager::HandlePhysicsPostStep(StringHash event, VariantMap& eventData)
+{
+	if (GetEventSender() != GetScene()->GetComponent<NewtonPhysicsWorld>())
+		return;
+
+	physicsStepHistogram_.Add(physicsStepTimer_.GetUSec(false));
+
+	if (fixedStepUpdates_)
+		TickPieceSystems();
+}
@@ -1,12 +1,76 @@
 #pragma once
 #include "Urho3D/Urho3DAll.h"
 #include "ColorPallet.h"
+#include "PieceCatalog.h"
+#include "StepTimingHistogram.h"
+#include "NewtonPhysicsEvents.h"
+#include "PhysicsContactStream.h"
+
+
+#define CONTRAPTION_FILEID "MCON"
+#define CONTRAPTION_COMPRESSED_FILEID "MCOZ"
+#define CONTRAPTION_VERSION 1
 
 
-//class to manage pieces on a scene level. (attach to scene node)
 class Piece;
 class PieceSolidificationGroup;
+class PieceGroupMergedCollision;
+class PieceGroupMergedVisual;
 class PiecePoint;
+class PiecePointRow;
+class PieceGear;
+class PieceAimQuery;
+class PiecePointIndicatorRenderer;
+class PieceUndoJournal;
+class PieceManager;
+class NewtonRigidBody;
+struct ContraptionFileData;
+
+
+//slot a component holds in one of the PieceManager registries.
+struct PieceRegistryHandle
+{
+	WeakPtr<PieceManager> manager_;
+	unsigned index_ = M_MAX_UNSIGNED;
+};
+
+//dense list of components of one type.  T must have a public PieceRegistryHandle registryHandle_ so removal is an O(1) swap-remove.
+template <class T>
+class PieceComponentRegistry
+{
+public:
+
+	void Add(T* comp)
+	{
+		if (comp->registryHandle_.index_ != M_MAX_UNSIGNED)
+			return;
+
+		comp->registryHandle_.index_ = items_.size();
+		items_.push_back(comp);
+	}
+
+	void Remove(T* comp)
+	{
+		unsigned index = comp->registryHandle_.index_;
+		if (index >= items_.size() || items_[index] != comp)
+			return;
+
+		items_[index] = items_.back();
+		items_[index]->registryHandle_.index_ = index;
+		items_.pop_back();
+
+		comp->registryHandle_.index_ = M_MAX_UNSIGNED;
+	}
+
+	const ea::vector<T*>& GetAll() const { return items_; }
+
+	unsigned Size() const { return items_.size(); }
+
+protected:
+	ea::vector<T*> items_;
+};
+
+//class to manage pieces on a scene level. (attach to scene node)
 class PieceManager : public Component
 {
 	URHO3D_OBJECT(PieceManager, Component);
@@ -17,10 +81,16 @@ public:
 	{
 		SubscribeToEvent(E_NODEADDED, URHO3D_HANDLER(PieceManager, HandleNodeAdded));
 		SubscribeToEvent(E_NODEREMOVED, URHO3D_HANDLER(PieceManager, HandleNodeRemoved));
+		SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(PieceManager, HandleUpdate));
+		SubscribeToEvent(E_NEWTON_PHYSICSPRESTEP, URHO3D_HANDLER(PieceManager, HandlePhysicsPreStep));
+		SubscribeToEvent(E_NEWTON_PHYSICSPOSTSTEP, URHO3D_HANDLER(PieceManager, HandlePhysicsPostStep));
+		SubscribeToEvent(E_PHYSICSCONTACTS, URHO3D_HANDLER(PieceManager, HandlePhysicsContacts));
 
 		colorPalletManager_ = context->CreateObject<ColorPalletManager>();
 	}
 
+	virtual ~PieceManager();
+
 	static void RegisterObject(Context* context)
 	{
 		context->RegisterFactory<PieceManager>();
@@ -42,12 +112,108 @@ public:
 	void SetEnableDynamicRodDetachment(bool enable) { enableDynamicRodDetach_ = enable; }
 	bool GetEnableDynamicRodDetachment() const { return enableDynamicRodDetach_; }
 
+	///when enabled rows and gears tick once per physics step instead of once per frame, so countdowns such as dynamic detachment
+	///count physics steps and a run with a fixed frame time step is reproducible.  off by default.
+	void SetFixedStepUpdates(bool enable) { fixedStepUpdates_ = enable; }
+	bool GetFixedStepUpdates() const { return fixedStepUpdates_; }
+
+	///contraption LOD: a contraption farther than the LOD distance from the viewer, or idle for the LOD idle time, is wrapped in a
+	///PieceSolidificationGroup whose solid state is pushed so it simulates as one body.  the state is popped again (and the wrapper removed)
+	///when the viewer comes back within the wake distance, the contraption is knocked into motion or a tool touches it (WakeContraption).
+	///frozen contraptions are left alone.  off by default.
+	void SetLodEnabled(bool enable);
+	bool GetLodEnabled() const { return lodEnabled_; }
+
+	void SetLodViewer(Node* viewer) { lodViewer_ = viewer; }
+	void SetLodDistance(float distance) { lodDistance_ = distance; }
+	float GetLodDistance() const { return lodDistance_; }
+	void SetLodIdleTime(float seconds) { lodIdleTime_ = seconds; }
+	float GetLodIdleTime() const { return lodIdleTime_; }
+
+	///restore full simulation of the contraption containing piece if it is LOD solidified.
+	void WakeContraption(Piece* piece);
+
+	///restore full simulation of every LOD solidified contraption.
+	void WakeAllContraptions();
+
+	unsigned GetNumLodContraptions() const { return lodContraptions_.size(); }
+
+	///pick up the LOD wrappers of a loaded scene (the wrapper flag is saved with the group) so they wake like ones made this session.
+	void RestoreLodContraptions();
+
+	///put the piece collision shapes and view masks back in place of merged ones before a scene save, and merge them again after (EndSceneSave).
+	///merged shapes and models are temporary - without this a saved group has no enabled shapes and hidden pieces.
+	void BeginSceneSave();
+	void EndSceneSave();
+
+	///bring a loaded scene back to its running state: piece shapes left disabled by a merge in the saved scene are enabled,
+	///solid states rebuilt and LOD wrappers restored.
+	void SetupAfterSceneLoad();
+
+	///simulation rate scheduling: a contraption farther than the reduced rate distance from the LOD viewer (or outside the schedule camera
+	///and farther than the off screen rate distance) is solved only every reduced rate interval physics steps and held kinematic and still
+	///in between.  its solve step runs at interval times its speed (gravity included), so it catches up on the held steps and keeps pace
+	///with the rest of the scene, moving in interval sized steps.  one beyond the frozen rate distance is held still throughout.
+	///any new contact (static bodies included), a tool (WakeContraption) or the viewer coming back promotes it to full rate with the velocity
+	///it had; after a contact it stays at full rate for the contact hold time.  contacts come from the scene's PhysicsContactStream, created if missing.
+	///frozen, held and LOD solidified contraptions are left alone.  off by default.
+	void SetRateSchedulingEnabled(bool enable);
+	bool GetRateSchedulingEnabled() const { return rateSchedulingEnabled_; }
+
+	void SetScheduleCamera(Camera* camera) { scheduleCamera_ = camera; }
+	void SetReducedRateDistance(float distance) { reducedRateDistance_ = distance; }
+	float GetReducedRateDistance() const { return reducedRateDistance_; }
+	void SetFrozenRateDistance(float distance) { frozenRateDistance_ = distance; }
+	float GetFrozenRateDistance() const { return frozenRateDistance_; }
+	void SetReducedRateInterval(unsigned steps) { reducedRateInterval_ = Max(steps, 1u); }
+	unsigned GetReducedRateInterval() const { return reducedRateInterval_; }
+	///being outside the schedule camera only counts beyond this distance from the viewer - the player may turn around at any time.
+	void SetOffScreenRateDistance(float distance) { offScreenRateDistance_ = distance; }
+	float GetOffScreenRateDistance() const { return offScreenRateDistance_; }
+	void SetRateContactHoldTime(float seconds) { rateContactHoldTime_ = seconds; }
+
+	///back to full rate.
+	void PromoteContraption(Piece* piece);
+	void PromoteAllContraptions();
+
+	unsigned GetNumReducedRateContraptions() const;
+	unsigned GetNumFrozenRateContraptions() const;
+
+	///durations of physics steps and of piece system ticks.
+	StepTimingHistogram& GetPhysicsStepHistogram() { return physicsStepHistogram_; }
+	StepTimingHistogram& GetPieceTickHistogram() { return pieceTickHistogram_; }
+
+	///when enabled each solidified group is drawn as one merged model per material instead of per-piece models.
+	void SetRenderMergeSolidGroups(bool enable) { renderMergeSolidGroups_ = enable; RebuildSolidifies(); }
+	bool GetRenderMergeSolidGroups() const { return renderMergeSolidGroups_; }
+
+	///fuse the piece box shapes of top solidified groups into fewer, larger boxes (PieceGroupMergedCollision).
+	void SetMergeSolidGroupCollision(bool enable) { mergeSolidGroupCollision_ = enable; RebuildSolidifies(); }
+	bool GetMergeSolidGroupCollision() const { return mergeSolidGroupCollision_; }
+
 
 
 	//piece creation
 
 	Node* CreatePiece(ea::string name, bool loadExisting);
 
+	///spawn a piece from a precomputed description (PieceCatalog entry or runtime prototype).
+	Node* CreatePieceFromCatalog(const PieceCatalogEntry& entry);
+
+	///names of all piece types CreatePiece can build procedurally.
+	static void GetProceduralPieceNames(ea::vector<ea::string>& names);
+
+	///every resource (type, name) piece creation and piece materials fetch from the ResourceCache.  used to pre-warm the cache.
+	static void GetPieceResources(ea::vector<ea::pair<StringHash, ea::string>>& resources);
+
+	///when enabled (default) CreatePiece uses the PieceCatalog subsystem for piece types it holds.
+	void SetUsePieceCatalog(bool enable) { usePieceCatalog_ = enable; }
+	bool GetUsePieceCatalog() const { return usePieceCatalog_; }
+
+	///when enabled (default) the first procedural build of a piece type is captured as a prototype and later spawns of that type are instantiated from it.
+	void SetUsePiecePrototypes(bool enable) { usePiecePrototypes_ = enable; if (!enable) piecePrototypes_.clear(); }
+	bool GetUsePiecePrototypes() const { return usePiecePrototypes_; }
+
 	Node* CreatePieceAssembly(ea::string name, bool loadExisting);
 
 	void UnPackAssembly(Node* assemblyRoot, ea::vector<Node*>& pieceNodes = ea::vector<Node*>());
@@ -55,6 +221,28 @@ public:
 	//contraption utils
 	void GetAllPointsInContraption(Piece* pieceInContraption, ea::vector<PiecePoint*>& points);
 
+	///compact binary save of all pieces in the scene: piece types, transforms, colors, row attachments by index and the group tree.
+	bool SaveContraption(Serializer& dest);
+	///snapshot everything SaveContraption writes into plain data that can be serialized off the main thread.
+	void CaptureContraption(ContraptionFileData& data);
+	///snapshot only the given pieces.  attachments to pieces outside the list are left out.
+	void CaptureContraption(ContraptionFileData& data, const ea::vector<Piece*>& pieces, bool withGroups);
+	bool SaveContraptionFile(const ea::string& fileName);
+
+	///re-creates pieces saved with SaveContraption alongside whatever is already in the scene.  use RemoveAllPieces() first to replace.
+	bool LoadContraption(Deserializer& source);
+	///memory maps the file and loads it with LoadContraption.
+	bool LoadContraptionFile(const ea::string& fileName);
+
+	///removes all pieces, groups and leftover assembly roots from the scene.
+	void RemoveAllPieces();
+
+	///resolves the saved component ids of loaded rows, points and attachments through one id table built from the registries.
+	///runs from ApplyAttributes - the scene component is applied after every child component has been loaded and registered.
+	void ResolveLoadedReferences();
+
+	virtual void ApplyAttributes() override;
+
 
 
 
@@ -81,6 +269,9 @@ public:
 
 	void GetPointsInRadius(ea::vector<PiecePoint*>& pieces, Vector3 worldPosition, float radius);
 
+	///returns the frame-cached aim query for the given look node (created on first use).
+	PieceAimQuery* GetAimQuery(Node* lookNode);
+
 	Piece* GetClosestAimPiece(Vector3& worldPos, Node* lookNode);
 
 	PiecePoint* GetClosestAimPiecePoint(Node* lookNode);
@@ -117,6 +308,18 @@ public:
 	///Resolves solidification state for all groups.
 	void RebuildSolidifies();
 
+	///Resolves solidification state only for the top level branches (children of the scene) containing the given nodes.
+	///use after changing group membership of a few pieces - cost is the size of those branches instead of the whole scene.
+	void RebuildSolidifiesBranches(const ea::vector<Node*>& nodes);
+
+	///a piece or group node added to or removed from a group rebuilds that group's branch.  code that moves many pieces and rebuilds the
+	///touched branches itself afterwards suspends those per-node rebuilds around the moves.  calls nest.
+	void SuspendNodeRebuilds() { nodeRebuildsSuspended_++; }
+	void ResumeNodeRebuilds() { nodeRebuildsSuspended_--; }
+
+	///the body currently simulating the piece - its own, or the first enabled group body above it (nested and non solid groups are skipped).
+	static NewtonRigidBody* GetActiveBody(Piece* piece);
+
 	///removes groups if the node has no piece's on children nodes. continues down the tree.
 	void CleanGroups(Node* node);
 
@@ -124,6 +327,17 @@ public:
 
 	///find all pieces that are rigidly connected starting at the startingPiece.
 	void GetRigidlyConnectedPieces(Piece* startingPiece, ea::vector<Piece*>& pieces);
+
+	///contraption ids: pieces connected through row attachments or assemblies share an id (1..GetNumContraptions()).
+	///ids are reassigned lazily in one O(n) pass after any attach, detach, assembly change or piece add/remove.
+	void MarkContraptionsDirty() { contraptionIdsDirty_ = true; connectivityVersion_++; }
+	void UpdateContraptionIds();
+	unsigned GetContraptionId(Piece* piece);
+	unsigned GetNumContraptions() { UpdateContraptionIds(); return numContraptions_; }
+
+	///all pieces, grouped by contraption id (index id-1).
+	void GetContraptions(ea::vector<ea::vector<Piece*>>& contraptions);
+
 	
 	///form the largest solid group starting at the given piece.
 	PieceSolidificationGroup*  FormSolidGroup(Piece* startingPiece);
@@ -134,6 +348,13 @@ public:
 	void FormSolidGroupsOnContraption(Piece* startingPiece);
 	void AutoFormAllGroups();
 
+	///AutoFormAllGroups off the main thread.  the rigid connectivity graph is snapshotted now, clustered on a worker thread and the
+	///resulting group diff is applied at the start of a later frame - the current grouping keeps simulating until then.
+	///a snapshot that went stale (pieces attached, detached, added or removed, or any group changed meanwhile) is thrown away and taken again.
+	///LOD wrapped contraptions are left out - their grouping is restored when they wake.
+	void RequestAutoFormAllGroups();
+	bool IsGroupFormationPending() const { return groupFormationRequested_ || groupFormationItem_; }
+
 
 	void FindLoops(Piece* piece, ea::vector<ea::vector<Piece*>>& loops);
 	void FindLoops(Piece* piece, ea::vector<ea::vector<Piece*>>& loops, ea::vector<Piece*>& traverseStack, int depth);
@@ -143,11 +364,206 @@ public:
 
 
 
+	///component registries - kept up to date by the components themselves in OnNodeSet.  iterate these instead of scanning the scene.
+	const ea::vector<Piece*>& GetAllPieces() const { return pieceRegistry_.GetAll(); }
+	const ea::vector<PiecePoint*>& GetAllPiecePoints() const { return pointRegistry_.GetAll(); }
+	const ea::vector<PiecePointRow*>& GetAllPiecePointRows() const { return rowRegistry_.GetAll(); }
+	const ea::vector<PieceGear*>& GetAllPieceGears() const { return gearRegistry_.GetAll(); }
+	const ea::vector<PieceSolidificationGroup*>& GetAllSolidGroups() const { return groupRegistry_.GetAll(); }
+
+	///add/remove a component to/from the registry of its type.
+	template <class T> static void RegisterComponent(T* comp);
+	template <class T> static void UnRegisterComponent(T* comp);
+
+	PieceComponentRegistry<Piece>& GetRegistry(Piece*) { return pieceRegistry_; }
+	PieceComponentRegistry<PiecePoint>& GetRegistry(PiecePoint*) { return pointRegistry_; }
+	PieceComponentRegistry<PiecePointRow>& GetRegistry(PiecePointRow*) { return rowRegistry_; }
+	PieceComponentRegistry<PieceGear>& GetRegistry(PieceGear*) { return gearRegistry_; }
+	PieceComponentRegistry<PieceSolidificationGroup>& GetRegistry(PieceSolidificationGroup*) { return groupRegistry_; }
+
+
+	///returns the scene's point indicator renderer (created on first use).
+	PiecePointIndicatorRenderer* GetPointIndicatorRenderer();
+
+	///returns the scene's undo journal (created on first use).
+	PieceUndoJournal* GetUndoJournal();
+
+
+
 	SharedPtr<ColorPalletManager> colorPalletManager_;
 protected:
 
+	WeakPtr<PiecePointIndicatorRenderer> pointIndicatorRenderer_;
+	WeakPtr<PieceUndoJournal> undoJournal_;
+
+	bool contraptionIdsDirty_ = true;
+	unsigned numContraptions_ = 0;
+	unsigned connectivityVersion_ = 0;
+	unsigned groupVersion_ = 0;//bumped by every solidify rebuild - group membership or solid state may have changed.
+	unsigned nodeRebuildsSuspended_ = 0;
+
+	//everything the group formation worker touches.  pieces and groups are referenced by index into the snapshot.
+	struct GroupFormationJob : public RefCounted {
+		unsigned connectivityVersion_ = 0;
+		unsigned groupVersion_ = 0;
+		ea::vector<WeakPtr<Node>> pieceNodes_;
+		ea::vector<ea::vector<unsigned>> rigidNeighbors_;
+		ea::vector<unsigned> pieceGroups_;//immediate group of each piece, M_MAX_UNSIGNED if none
+		ea::vector<WeakPtr<Node>> groupNodes_;
+		ea::vector<unsigned> groupSizes_;
+
+		ea::vector<ea::vector<unsigned>> newClusters_;//rigid clusters that need a new group
+		ea::vector<bool> keepGroups_;//existing groups that already hold exactly one cluster
+	};
+
+	static void GroupFormationWork(const WorkItem* item, unsigned threadIndex);
+	void StartGroupFormation();
+	void FinishGroupFormation();
+	void CancelGroupFormation();
+
+	bool groupFormationRequested_ = false;
+	SharedPtr<GroupFormationJob> groupFormationJob_;
+	SharedPtr<WorkItem> groupFormationItem_;
+
+	bool renderMergeSolidGroups_ = false;
+	bool mergeSolidGroupCollision_ = false;
+	ea::vector<WeakPtr<PieceGroupMergedCollision>> savedCollisionMerges_;
+	ea::vector<WeakPtr<PieceGroupMergedVisual>> savedVisualMerges_;
+
+	bool usePieceCatalog_ = true;
+
+	bool usePiecePrototypes_ = true;
+	ea::hash_map<StringHash, PieceCatalogEntry> piecePrototypes_;
+
+	PieceComponentRegistry<Piece> pieceRegistry_;
+	PieceComponentRegistry<PiecePoint> pointRegistry_;
+	PieceComponentRegistry<PiecePointRow> rowRegistry_;
+	PieceComponentRegistry<PieceGear> gearRegistry_;
+	PieceComponentRegistry<PieceSolidificationGroup> groupRegistry_;
+
 	void HandleNodeAdded(StringHash event, VariantMap& eventData);
 	void HandleNodeRemoved(StringHash event, VariantMap& eventData);
+	//a piece or group node joined or is leaving the group on parentNode.
+	void HandleGroupMembershipChange(Node* node, Node* parentNode);
+
+	//tick every row and gear from the registries.
+	void TickPieceSystems();
+
+	//velocity of a piece before a solidify rebuild, taken from whichever body was simulating it.
+	struct BodyMotion {
+		Vector3 linear_;
+		Vector3 angular_;
+	};
+
+	//rebuilds switch group and piece bodies on and off instead of recreating them.  the motion of every piece is captured before
+	//the switch and handed to the bodies that were switched on, so toggling a moving group does not stop it.
+	//this carries velocity over only - switching a body off removes it from the Newton world, so a switched on body is added again
+	//and starts awake with no contacts.  only the branches being rebuilt are captured.
+	void CaptureBodyMotion(Node* branch, ea::hash_map<Piece*, BodyMotion>& motion);
+	void ApplyBodyMotion(const ea::hash_map<Piece*, BodyMotion>& motion);
+
+	ea::vector<WeakPtr<NewtonRigidBody>> activatedBodies_;
+
+	void HandleUpdate(StringHash event, VariantMap& eventData);
+	void HandlePhysicsPreStep(StringHash event, VariantMap& eventData);
+	void HandlePhysicsPostStep(StringHash event, VariantMap& eventData);
+
+	bool fixedStepUpdates_ = false;
+
+	struct LodContraption {
+		WeakPtr<PieceSolidificationGroup> group_;
+		float radius_ = 0.0f;
+		bool idle_ = false;//solidified for being idle rather than distant - the viewer approaching does not wake it.
+	};
+
+	void UpdateLod(float timeStep);
+	void SolidifyContraptionLod(const ea::vector<Piece*>& pieces, const Vector3& center, float radius, bool idle);
+	void WakeLodGroup(PieceSolidificationGroup* group);
+
+	bool lodEnabled_ = false;
+	WeakPtr<Node> lodViewer_;
+	float lodDistance_ = 40.0f;
+	float lodWakeDistanceFactor_ = 0.8f;
+	float lodIdleTime_ = 10.0f;
+	float lodIdleSpeed_ = 0.05f;
+	float lodWakeSpeed_ = 0.5f;
+	float lodUpdateInterval_ = 0.5f;
+	float lodTimer_ = 0.0f;
+	ea::vector<LodContraption> lodContraptions_;
+	ea::hash_map<unsigned, float> lodIdleTimes_;//by lowest piece node id of the contraption
+
+	enum ContraptionSimRate {
+		ContraptionSimRate_Full = 0,
+		ContraptionSimRate_Reduced,
+		ContraptionSimRate_Frozen
+	};
+
+	struct ScheduledContraption {
+		ContraptionSimRate rate_ = ContraptionSimRate_Full;
+		unsigned phase_ = 0;//spreads the solve steps of reduced contraptions over the interval.
+		bool solving_ = false;//dynamic this step.
+		unsigned resumeStep_ = 0;//rate step the current solve step started in.
+		float solveScale_ = 1.0f;//speed up of the current solve step.
+		ea::vector<WeakPtr<NewtonRigidBody>> bodies_;
+		ea::vector<BodyMotion> motion_;//velocity of each body while kinematic.
+	};
+
+	void UpdateRateSchedule();
+	void ScheduleContraption(unsigned key, const ea::vector<Piece*>& pieces, ContraptionSimRate rate);
+	void PromoteScheduled(unsigned key);
+	void PromoteOnContact(unsigned key, NewtonRigidBody* other);
+	void StepRateSchedule(float timeStep);
+	//velocity at normal speed of a body at the end of its contraption's solve step.
+	void GetSolvedMotion(const ScheduledContraption& contraption, NewtonRigidBody* body, BodyMotion& motion) const;
+	void HandlePhysicsContacts(StringHash event, VariantMap& eventData);
+
+	bool rateSchedulingEnabled_ = false;
+	WeakPtr<Camera> scheduleCamera_;
+	float reducedRateDistance_ = 25.0f;
+	float frozenRateDistance_ = 60.0f;
+	float rateWakeDistanceFactor_ = 0.8f;
+	unsigned reducedRateInterval_ = 4;
+	float offScreenRateDistance_ = 15.0f;
+	float rateContactHoldTime_ = 3.0f;
+	float rateUpdateInterval_ = 0.5f;
+	float rateTimer_ = 0.0f;
+	unsigned rateStep_ = 0;
+	float rateTimeStep_ = 0.0f;//length of the last physics step the schedule saw.
+	unsigned rateScheduleVersion_ = 0;//connectivity version the schedule was made for.
+	ea::hash_map<unsigned, ScheduledContraption> scheduledContraptions_;//by lowest piece node id of the contraption
+	ea::hash_map<NewtonRigidBody*, unsigned> scheduledBodies_;//lookup only - never dereferenced.
+	ea::hash_map<unsigned, float> rateContactHolds_;//scene time until which a contraption promoted by contact stays at full rate, by key
+
+	HiresTimer physicsStepTimer_;
+	StepTimingHistogram physicsStepHistogram_;
+	StepTimingHistogram pieceTickHistogram_;
 
 };
 
+
+template <class T>
+void PieceManager::RegisterComponent(T* comp)
+{
+	Scene* scene = comp->GetScene();
+	if (!scene)
+		return;
+
+	PieceManager* manager = scene->GetComponent<PieceManager>();
+	if (!manager)
+		return;
+
+	UnRegisterComponent(comp);
+
+	comp->registryHandle_.manager_ = manager;
+	manager->GetRegistry(comp).Add(comp);
+}
+
+template <class T>
+void PieceManager::UnRegisterComponent(T* comp)
+{
+	if (comp->registryHandle_.manager_)
+		comp->registryHandle_.manager_->GetRegistry(comp).Remove(comp);
+
+	comp->registryHandle_.manager_ = nullptr;
+	comp->registryHandle_.index_ = M_MAX_UNSIGNED;
+}
@@ -2,6 +2,7 @@
 #include "Piece.h"
 #include "PieceManager.h"
 #include "PiecePointRow.h"
+#include "PiecePointIndicatorRenderer.h"
 
 
 
@@ -35,6 +36,19 @@ bool PiecePoint::OccupancyCompatible(PiecePoint* point)
 
 
 
+//returns the scene's shared indicator renderer, or null when the point is detached or the scene has no PieceManager.
+static PiecePointIndicatorRenderer* GetIndicatorRenderer(Scene* scene)
+{
+	if (!scene)
+		return nullptr;
+
+	PieceManager* manager = scene->GetComponent<PieceManager>();
+	if (!manager)
+		return nullptr;
+
+	return manager->GetPointIndicatorRenderer();
+}
+
 Piece* PiecePoint::GetPiece()
 {
 	return node_->GetParent()->GetComponent<Piece>();
@@ -45,22 +59,8 @@ void PiecePoint::SetShowBasisIndicator(bool enable)
 	if (showBasisIndicator_ != enable)
 	{
 		showBasisIndicator_ = enable;
-		if (showBasisIndicator_)
-		{
-			if(basisIndicatorNode_.Expired())
-				basisIndicatorNode_ = node_->CreateChild();
-			
-			basisIndicatorNode_->SetScale(0.1f);
-			basisIndicatorStMdl_ = basisIndicatorNode_->CreateComponent<StaticModel>();
-			basisIndicatorStMdl_->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/LinePrimitives/Basis.mdl"));
-		}
-		else
-		{
-			basisIndicatorNode_->RemoveComponent(basisIndicatorStMdl_);
-			
-			if (basisIndicatorNode_->GetNumComponents() <= 0)
-				basisIndicatorNode_->Remove();
-		}
+		if (PiecePointIndicatorRenderer* renderer = GetIndicatorRenderer(GetScene()))
+			renderer->SetBasisIndicator(this, showBasisIndicator_);
 	}
 }
 
@@ -72,10 +72,8 @@ void PiecePoint::SetShowColorIndicator(bool enable, Color color)
 		showColorIndicator_ = enable;
 		colorIndicatorColor_ = color;
 
-
-		//URHO3D_LOGINFO("color update.");
-		colorIndicatorStMdl_->GetMaterial()->SetShaderParameter("MatDiffColor", color.ToVector4());
-		colorIndicatorStMdl_->SetEnabled(showColorIndicator_);
+		if (PiecePointIndicatorRenderer* renderer = GetIndicatorRenderer(GetScene()))
+			renderer->SetColorIndicator(this, showColorIndicator_, colorIndicatorColor_);
 	}
 }
 
@@ -86,8 +84,7 @@ bool PiecePoint::Weld()
 		isWelded = true;
 		occupiedPoint_->isWelded = true;
 		URHO3D_LOGINFO("Welding..");
-		GetScene()->GetComponent<PieceManager>()->FormSolidGroup(GetPiece());
-		GetScene()->GetComponent<PieceManager>()->FormSolidGroup(occupiedPoint_->GetPiece());
+		GetScene()->GetComponent<PieceManager>()->RequestAutoFormAllGroups();
 
 	}
 	else
@@ -107,8 +104,7 @@ bool PiecePoint::UnWeld()
 
 
 
-		GetScene()->GetComponent<PieceManager>()->FormSolidGroup(GetPiece());
-		GetScene()->GetComponent<PieceManager>()->FormSolidGroup(occupiedPoint_->GetPiece());
+		GetScene()->GetComponent<PieceManager>()->RequestAutoFormAllGroups();
 		return true;
 	}
 	return false;
@@ -133,39 +129,14 @@ bool PiecePoint::LoadXML(const XMLElement& source)
 	return s;
 }
 
-void PiecePoint::ApplyAttributes()
-{
-	SceneResolver sceneResolver;
-	Component* comp = GetScene()->GetComponent(rowId_);
-	sceneResolver.AddComponent(rowId_, comp);
-	sceneResolver.Resolve();
-	row_ = dynamic_cast<PiecePointRow*>(GetScene()->GetComponent(comp->GetID()));
-}
-
-
-
 void PiecePoint::OnNodeSet(Node* node)
 {
 	if (node)
 	{
-
-		//make color indicator
-		SharedPtr<Material> mat = GetSubsystem<ResourceCache>()->GetResource<Material>("Materials/DefaultMaterial.xml")->Clone();
-
-		colorIndicatorNode_ = node_->CreateChild();
-
-		colorIndicatorNode_->SetScale(0.02f);
-		colorIndicatorStMdl_ = colorIndicatorNode_->CreateComponent<StaticModel>();
-		colorIndicatorStMdl_->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/Sphere.mdl"));
-
-
-		mat->SetTechnique(0, GetSubsystem<ResourceCache>()->GetResource<Technique>("Techniques/NoTextureOverlay.xml"));
-		colorIndicatorStMdl_->SetMaterial(mat);
-		colorIndicatorStMdl_->SetEnabled(false);
+		PieceManager::RegisterComponent(this);
 	}
 	else
 	{
-
+		PieceManager::UnRegisterComponent(this);
 	}
 }
-
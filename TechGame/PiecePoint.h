@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Urho3D/Urho3DAll.h>
+#include "PieceManager.h"
 
 
 
@@ -39,6 +40,8 @@ public:
 	bool IsWelded() const { return isWelded; }
 	bool Weld();
 	bool UnWeld();
+	///restore the weld flag without re-forming groups (loading).
+	void SetWeldedAttrib(bool welded) { isWelded = welded; }
 
 
 
@@ -58,10 +61,6 @@ public:
 	WeakPtr<PiecePoint> occupiedPoint_;//other point that is "occupying the space of this point"
 	WeakPtr<PiecePoint> occupiedPointPrev_;
 
-	WeakPtr<StaticModel> basisIndicatorStMdl_;
-	WeakPtr<StaticModel> colorIndicatorStMdl_;
-	WeakPtr<Node> basisIndicatorNode_;
-	WeakPtr<Node> colorIndicatorNode_;
 	Color colorIndicatorColor_;
 
 
@@ -69,9 +68,9 @@ public:
 	virtual bool LoadXML(const XMLElement& source) override;
 
 
-	virtual void ApplyAttributes() override;
-
 
+	//slot in the PieceManager registry (maintained in OnNodeSet).
+	PieceRegistryHandle registryHandle_;
 
 protected:
 
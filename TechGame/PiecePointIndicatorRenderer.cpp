@@ -0,0 +1,147 @@
+#include "PiecePointIndicatorRenderer.h"
+#include "PiecePoint.h"
+#include "PieceAimQuery.h"
+
+
+
+PiecePointIndicatorRenderer::PiecePointIndicatorRenderer(Context* context) : Component(context)
+{
+	SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(PiecePointIndicatorRenderer, HandlePostUpdate));
+}
+
+void PiecePointIndicatorRenderer::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PiecePointIndicatorRenderer>();
+}
+
+void PiecePointIndicatorRenderer::SetColorIndicator(PiecePoint* point, bool enable, Color color)
+{
+	unsigned id = point->GetID();
+	auto it = indicatorIndices_.find(id);
+
+	if (enable)
+	{
+		if (it != indicatorIndices_.end())
+		{
+			indicators_[it->second].color_ = color;
+		}
+		else
+		{
+			Indicator indicator;
+			indicator.point_ = point;
+			indicator.pointId_ = id;
+			indicator.color_ = color;
+
+			indicatorIndices_.insert_or_assign(id, indicators_.size());
+			indicators_.push_back(indicator);
+		}
+	}
+	else if (it != indicatorIndices_.end())
+	{
+		RemoveIndicatorAt(it->second);
+	}
+}
+
+void PiecePointIndicatorRenderer::SetBasisIndicator(PiecePoint* point, bool enable)
+{
+	if (enable)
+	{
+		basisPoint_ = point;
+	}
+	else if (basisPoint_ == point)
+	{
+		basisPoint_ = nullptr;
+	}
+}
+
+void PiecePointIndicatorRenderer::ClearColorIndicators()
+{
+	indicators_.clear();
+	indicatorIndices_.clear();
+}
+
+void PiecePointIndicatorRenderer::RemoveIndicatorAt(unsigned index)
+{
+	//swap-remove to keep the list dense.
+	indicatorIndices_.erase(indicators_[index].pointId_);
+
+	if (index != indicators_.size() - 1)
+	{
+		indicators_[index] = indicators_.back();
+		indicatorIndices_.insert_or_assign(indicators_[index].pointId_, index);
+	}
+	indicators_.pop_back();
+}
+
+void PiecePointIndicatorRenderer::HandlePostUpdate(StringHash event, VariantMap& eventData)
+{
+	if (billboards_.Expired())
+		return;
+
+	//drop indicators of points that have been removed.
+	for (int i = int(indicators_.size()) - 1; i >= 0; i--)
+	{
+		if (indicators_[i].point_.Expired())
+			RemoveIndicatorAt(i);
+	}
+
+	if (billboards_->GetNumBillboards() != indicators_.size())
+		billboards_->SetNumBillboards(indicators_.size());
+
+	for (unsigned i = 0; i < indicators_.size(); i++)
+	{
+		Billboard* bb = billboards_->GetBillboard(i);
+		bb->position_ = indicators_[i].point_->GetNode()->GetWorldPosition();
+		bb->size_ = Vector2(POINT_INDICATOR_SIZE, POINT_INDICATOR_SIZE);
+		bb->color_ = indicators_[i].color_;
+		bb->enabled_ = true;
+	}
+	billboards_->Commit();
+
+
+	if (!basisNode_.Expired())
+	{
+		if (!basisPoint_.Expired())
+		{
+			basisNode_->SetWorldTransform(basisPoint_->GetNode()->GetWorldPosition(), basisPoint_->GetNode()->GetWorldRotation(), 0.1f);
+			basisNode_->SetEnabled(true);
+		}
+		else if (basisNode_->IsEnabled())
+		{
+			basisNode_->SetEnabled(false);
+		}
+	}
+}
+
+void PiecePointIndicatorRenderer::OnNodeSet(Node* node)
+{
+	if (node)
+	{
+		ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+		indicatorNode_ = node->CreateChild("pointIndicators");
+		indicatorNode_->SetTemporary(true);
+
+		billboards_ = indicatorNode_->CreateComponent<BillboardSet>();
+		billboards_->SetMaterial(cache->GetResource<Material>("Materials/PointIndicator.xml"));
+		billboards_->SetRelative(false);
+		billboards_->SetSorted(false);
+		billboards_->SetFaceCameraMode(FC_ROTATE_XYZ);
+		billboards_->SetViewMask(DEFAULT_VIEWMASK & ~PIECE_VIEWMASK_PICKABLE);
+
+		basisNode_ = indicatorNode_->CreateChild("basisIndicator");
+		basisNode_->SetTemporary(true);
+		StaticModel* basisModel = basisNode_->CreateComponent<StaticModel>();
+		basisModel->SetModel(cache->GetResource<Model>("Models/LinePrimitives/Basis.mdl"));
+		basisModel->SetViewMask(DEFAULT_VIEWMASK & ~PIECE_VIEWMASK_PICKABLE);
+		basisNode_->SetEnabled(false);
+	}
+	else
+	{
+		if (!indicatorNode_.Expired())
+			indicatorNode_->Remove();
+
+		ClearColorIndicators();
+		basisPoint_ = nullptr;
+	}
+}
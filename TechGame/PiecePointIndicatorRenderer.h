@@ -0,0 +1,57 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+//size in world units of a color indicator dot.
+#define POINT_INDICATOR_SIZE 0.03f
+
+
+class PiecePoint;
+
+//scene level renderer for PiecePoint indicators.  all color indicators are drawn as billboards out of one dynamic buffer (single batch),
+//and the single basis indicator is a pooled node that is moved to whichever point currently shows it.  points never get indicator nodes of their own.
+class PiecePointIndicatorRenderer : public Component
+{
+	URHO3D_OBJECT(PiecePointIndicatorRenderer, Component);
+
+public:
+
+	PiecePointIndicatorRenderer(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	///show or hide a colored indicator on the given point.
+	void SetColorIndicator(PiecePoint* point, bool enable, Color color);
+
+	///show or hide the basis indicator on the given point.  only one point shows the basis at a time.
+	void SetBasisIndicator(PiecePoint* point, bool enable);
+
+	///hide all color indicators.
+	void ClearColorIndicators();
+
+	unsigned GetNumColorIndicators() const { return indicators_.size(); }
+
+protected:
+
+	struct Indicator {
+		WeakPtr<PiecePoint> point_;
+		unsigned pointId_ = 0;
+		Color color_;
+	};
+
+	void RemoveIndicatorAt(unsigned index);
+
+	void HandlePostUpdate(StringHash event, VariantMap& eventData);
+
+	virtual void OnNodeSet(Node* node) override;
+
+	//dense list of active indicators and point id -> index lookup.
+	ea::vector<Indicator> indicators_;
+	ea::hash_map<unsigned, unsigned> indicatorIndices_;
+
+	WeakPtr<Node> indicatorNode_;
+	WeakPtr<BillboardSet> billboards_;
+
+	WeakPtr<Node> basisNode_;
+	WeakPtr<PiecePoint> basisPoint_;
+};
@@ -2,6 +2,8 @@
 #include "PiecePoint.h"
 #include "Piece.h"
 #include "PieceManager.h"
+#include "PieceUndoJournal.h"
+#include "PhysicsReplay.h"
 
 #include "NewtonPhysicsWorld.h"
 #include "NewtonConstraint.h"
@@ -173,6 +175,16 @@ Urho3D::Vector3 PiecePointRow::GetWorldCenter()
 	return node_->LocalToWorld(GetLocalCenter());
 }
 
+unsigned PiecePointRow::GetPointIndex(PiecePoint* point) const
+{
+	for (unsigned i = 0; i < points_.size(); i++)
+	{
+		if (points_[i] == point)
+			return i;
+	}
+	return M_MAX_UNSIGNED;
+}
+
 bool PiecePointRow::AttachedToRow(PiecePointRow* row)
 {
 	for (int i = 0; i < rowAttachements_.size(); i++) {
@@ -217,6 +229,12 @@ bool PiecePointRow::DetachFrom(PiecePointRow* otherRow, bool updateOccupiedPoint
 
 
 	URHO3D_LOGINFO("PiecePointRow:: Row Detached");
+
+	if (detached)
+		GetScene()->GetComponent<PieceManager>()->MarkContraptionsDirty();
+
+	if (PhysicsReplayRecorder* recorder = GetScene()->GetComponent<PhysicsReplayRecorder>())
+		recorder->RecordEvent(PhysicsReplayEvent_Detach, this, otherRow);
 	if (updateOccupiedPoints) {
 		UpdatePointOccupancies();
 		otherRow->UpdatePointOccupancies();
@@ -477,6 +495,11 @@ bool PiecePointRow::AttachRows(PiecePointRow* rowA, PiecePointRow* rowB, PiecePo
 			UpdateOptimizeFullRow(rowA);
 			UpdateOptimizeFullRow(rowB);
 		}
+
+		pieceManager->MarkContraptionsDirty();
+
+		if (PhysicsReplayRecorder* recorder = rowA->GetScene()->GetComponent<PhysicsReplayRecorder>())
+			recorder->RecordEvent(PhysicsReplayEvent_Attach, rowA, rowB);
 		
 		return true;
 
@@ -830,25 +853,7 @@ bool PiecePointRow::LoadXML(const XMLElement& source)
 
 
 
-void PiecePointRow::ApplyAttributes()
-{
-
-	{
-		SceneResolver sceneResolver;
-		sceneResolver.Resolve();
-		for (unsigned id : pointIds_)
-		{
-			Component* comp = GetScene()->GetComponent(id);
-			sceneResolver.AddComponent(id, comp);
-			sceneResolver.Resolve();
-			points_.push_back(SharedPtr<PiecePoint>(dynamic_cast<PiecePoint*>(comp)));
-		}
-	}
-}
-
-
-
-void PiecePointRow::HandleUpdate(StringHash event, VariantMap& eventData)
+void PiecePointRow::Tick()
 {
 
 	UpdatePointOccupancies();
@@ -920,8 +925,12 @@ void PiecePointRow::UpdateDynamicDettachement()
 							
 							if (!rowAttachementsCopy[i].row_->HasAnEndCap() && !rowAttachementsCopy[i].rowOther_->HasAnEndCap())
 							{
+								PieceUndoJournal* journal = GetScene()->GetComponent<PieceManager>()->GetUndoJournal();
+								journal->BeginOperation("Detach", { GetPiece(), rowAttachementsCopy[i].rowOther_->GetPiece() });
+
 								DetachFrom(rowAttachementsCopy[i].rowOther_, true);
 
+								journal->EndOperation();
 							}
 
 						}
@@ -946,25 +955,11 @@ void PiecePointRow::OnNodeSet(Node* node)
 	if (node)
 	{
 		pieceManager_ = GetScene()->GetComponent<PieceManager>();
+		PieceManager::RegisterComponent(this);
 	}
 	else
 	{
 		points_.clear();
-	}
-}
-
-void PiecePointRow::DelayedStart()
-{
-	//resolve attachment data
-	{
-		for (RowAttachement& att : rowAttachements_)
-		{
-			att.constraint_ = dynamic_cast<NewtonConstraint*>(GetScene()->GetComponent(att.constraintId_));
-			att.point = dynamic_cast<PiecePoint*>(GetScene()->GetComponent(att.pointId));
-			att.pointOther_ = dynamic_cast<PiecePoint*>(GetScene()->GetComponent(att.pointOtherId_));
-			att.row_ = dynamic_cast<PiecePointRow*>(GetScene()->GetComponent(att.rowId_));
-			att.rowOther_ = dynamic_cast<PiecePointRow*>(GetScene()->GetComponent(att.rowOtherId_));
-		}
-	
+		PieceManager::UnRegisterComponent(this);
 	}
 }
@@ -47,11 +47,11 @@ public:
 
 
 	struct RowAttachement {
-		unsigned pointOtherId_;
-		unsigned pointId;
-		unsigned rowOtherId_;
-		unsigned rowId_;
-		unsigned constraintId_;
+		unsigned pointOtherId_ = 0;
+		unsigned pointId = 0;
+		unsigned rowOtherId_ = 0;
+		unsigned rowId_ = 0;
+		unsigned constraintId_ = 0;
 
 		WeakPtr<PiecePoint> pointOther_;
 		WeakPtr<PiecePoint> point;
@@ -64,8 +64,6 @@ public:
 	PiecePointRow(Context* context) : LogicComponent(context)
 	{
 		debugColor_ = Color(Random(1.0f), Random(1.0f), Random(1.0f), 0.2f);
-
-		SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(PiecePointRow, HandleUpdate));
 	}
 
 	static bool RowsAttachCompatable(PiecePointRow* rowA, PiecePointRow* rowB);
@@ -152,6 +150,9 @@ public:
 
 	const ea::vector<SharedPtr<PiecePoint>>& GetPoints() { return points_; }
 
+	///index of point in the row or M_MAX_UNSIGNED.
+	unsigned GetPointIndex(PiecePoint* point) const;
+
 	Vector3 GetLocalCenter();
 
 	Vector3 GetWorldCenter();
@@ -189,15 +190,15 @@ public:
 
 
 
-	virtual void ApplyAttributes() override;
-
 
+	//slot in the PieceManager registry (maintained in OnNodeSet).
+	PieceRegistryHandle registryHandle_;
 
+	///occupancy, full row optimization and dynamic detachment.  called by PieceManager once per frame, or per physics step in fixed step mode.
+	void Tick();
 
 protected:
 
-	void HandleUpdate(StringHash event, VariantMap& eventData);
-
 	void UpdatePointOccupancies();
 
 	void UpdateDynamicDettachement();
@@ -221,7 +222,6 @@ protected:
 	SharedPtr<PieceManager> pieceManager_;
 
 	virtual void OnNodeSet(Node* node) override;
-	virtual void DelayedStart() override;
 
 };
 
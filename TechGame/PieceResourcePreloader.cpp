@@ -0,0 +1,70 @@
+#include "PieceResourcePreloader.h"
+#include "PieceManager.h"
+
+
+
+PieceResourcePreloader::PieceResourcePreloader(Context* context) : Object(context)
+{
+}
+
+void PieceResourcePreloader::Start()
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+	ea::vector<ea::pair<StringHash, ea::string>> resources;
+	PieceManager::GetPieceResources(resources);
+
+	pending_.clear();
+	numQueued_ = 0;
+	numFailed_ = 0;
+	timer_.Reset();
+
+	SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(PieceResourcePreloader, HandleResourceBackgroundLoaded));
+
+	for (const auto& resource : resources)
+	{
+		if (cache->GetExistingResource(resource.first, resource.second))
+			continue;
+
+		//dependencies (textures of a material etc.) are queued by the cache itself.
+		if (cache->BackgroundLoadResource(resource.first, resource.second, true))
+		{
+			pending_.insert(resource.second);
+			numQueued_++;
+		}
+	}
+
+	if (pending_.empty())
+		UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+
+	URHO3D_LOGINFO("PieceResourcePreloader: queued " + ea::to_string(numQueued_) + " piece resources");
+}
+
+float PieceResourcePreloader::GetProgress() const
+{
+	if (!numQueued_)
+		return 1.0f;
+
+	return float(numQueued_ - pending_.size()) / float(numQueued_);
+}
+
+void PieceResourcePreloader::HandleResourceBackgroundLoaded(StringHash event, VariantMap& eventData)
+{
+	using namespace ResourceBackgroundLoaded;
+
+	const ea::string& name = eventData[P_RESOURCENAME].GetString();
+	if (!pending_.erase(name))
+		return;
+
+	if (!eventData[P_SUCCESS].GetBool())
+	{
+		URHO3D_LOGWARNING("PieceResourcePreloader: failed to load " + name);
+		numFailed_++;
+	}
+
+	if (pending_.empty())
+	{
+		UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+		URHO3D_LOGINFO("PieceResourcePreloader: piece resources ready in " + ea::to_string(timer_.GetUSec(false) / 1000) + " ms");
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+//startup stage that pulls every piece model, material and technique into the ResourceCache on the background loader threads,
+//so the first spawn or recolor of a piece type does not stall on disk io and parsing.  registered as a subsystem.
+class PieceResourcePreloader : public Object
+{
+	URHO3D_OBJECT(PieceResourcePreloader, Object);
+
+public:
+
+	PieceResourcePreloader(Context* context);
+
+	///queue all resources from PieceManager::GetPieceResources that are not loaded yet.
+	void Start();
+
+	bool IsFinished() const { return pending_.empty(); }
+
+	///0..1 over the resources queued by Start.
+	float GetProgress() const;
+
+	unsigned GetNumQueued() const { return numQueued_; }
+	unsigned GetNumFailed() const { return numFailed_; }
+
+protected:
+
+	void HandleResourceBackgroundLoaded(StringHash event, VariantMap& eventData);
+
+	ea::hash_set<ea::string> pending_;
+	unsigned numQueued_ = 0;
+	unsigned numFailed_ = 0;
+
+	HiresTimer timer_;
+};
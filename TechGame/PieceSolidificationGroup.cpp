@@ -1,6 +1,8 @@
 #include "Piece.h"
 #include "PieceSolidificationGroup.h"
 #include "PieceManager.h"
+#include "PieceGroupMergedVisual.h"
+#include "PieceGroupMergedCollision.h"
 #include "Urho3D/Core/Context.h"
 #include "Urho3D/Scene/Component.h"
 
@@ -23,6 +25,8 @@ PieceSolidificationGroup::PieceSolidificationGroup(Context* context) : Component
 void PieceSolidificationGroup::RegisterObject(Context* context)
 {
 	context->RegisterFactory<PieceSolidificationGroup>();
+
+	URHO3D_ATTRIBUTE("Lod Group", bool, lodGroup_, false, AM_DEFAULT);
 }
 
 
@@ -33,7 +37,7 @@ void PieceSolidificationGroup::SetSolidified(bool solid)
 {
 	if (solidStateStack_.back() != solid) {
 		solidStateStack_.back() = solid;
-		GetScene()->GetComponent<PieceManager>()->RebuildSolidifies();
+		GetScene()->GetComponent<PieceManager>()->RebuildSolidifiesBranches({ node_ });
 	}
 }
 
@@ -57,6 +61,62 @@ bool PieceSolidificationGroup::GetEffectivelySolidified() const
 	return hasSolid;
 }
 
+void PieceSolidificationGroup::SetRenderMerged(bool merged)
+{
+	if (merged)
+	{
+		PieceGroupMergedVisual* mergedVisual = node_->GetComponent<PieceGroupMergedVisual>();
+		if (!mergedVisual)
+		{
+			mergedVisual = node_->CreateComponent<PieceGroupMergedVisual>();
+			mergedVisual->SetTemporary(true);
+		}
+		mergedVisual->MarkDirty();
+	}
+	else
+	{
+		node_->RemoveComponent<PieceGroupMergedVisual>();
+	}
+}
+
+bool PieceSolidificationGroup::GetRenderMerged() const
+{
+	return node_->HasComponent<PieceGroupMergedVisual>();
+}
+
+void PieceSolidificationGroup::SetCollisionMerged(bool merged)
+{
+	PieceGroupMergedCollision* mergedCollision = node_->GetComponent<PieceGroupMergedCollision>();
+	if (merged)
+	{
+		if (!mergedCollision)
+		{
+			mergedCollision = node_->CreateComponent<PieceGroupMergedCollision>();
+			mergedCollision->SetTemporary(true);
+		}
+		mergedCollision->Rebuild();
+	}
+	else if (mergedCollision)
+	{
+		//kept around so re-solidifying the same pieces reuses the merge.  the pieces can move while unsolid, so their boxes are redone.
+		mergedCollision->Revert();
+		mergedCollision->Invalidate();
+	}
+}
+
+bool PieceSolidificationGroup::GetCollisionMerged() const
+{
+	PieceGroupMergedCollision* mergedCollision = node_->GetComponent<PieceGroupMergedCollision>();
+	return mergedCollision && mergedCollision->IsMerged();
+}
+
+void PieceSolidificationGroup::MarkRenderMergeDirty()
+{
+	PieceGroupMergedVisual* mergedVisual = node_->GetComponent<PieceGroupMergedVisual>();
+	if (mergedVisual)
+		mergedVisual->MarkDirty();
+}
+
 void PieceSolidificationGroup::GetPieces(ea::vector<Piece*>& pieces)
 {
 	//resolve which root nodes to consider.
@@ -116,11 +176,11 @@ void PieceSolidificationGroup::OnNodeSet(Node* node)
 {
 	if (node)
 	{
-
+		PieceManager::RegisterComponent(this);
 	}
 	else
 	{
-
+		PieceManager::UnRegisterComponent(this);
 	}
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 #include <Urho3D/Urho3DAll.h>
+#include "PieceManager.h"
+#include "NewtonRigidBody.h"
 
 
 //component that represents a group of pieces.  component is on a root node common to all pieces in the group.
@@ -19,18 +21,26 @@ public:
 
 	bool GetSolidified() const { return solidStateStack_.back(); }
 
+	///set the solid state without rebuilding (loading).  call PieceManager::RebuildSolidifies afterwards.
+	void SetSolidStateAttrib(bool solid) { solidStateStack_.back() = solid; }
+
 	void PushSolidState(bool solid)
 	{
-		solidStateStack_.push_back(solid);
-		SetSolidified(solidStateStack_.back());
+		//push a copy so SetSolidified sees the change and rebuilds.
+		solidStateStack_.push_back(solidStateStack_.back());
+		SetSolidified(solid);
 	}
 
 	bool PopSolidState()
 	{
 		if (solidStateStack_.size() > 1) {
+			bool popped = solidStateStack_.back();
 			solidStateStack_.pop_back();
 
-			SetSolidified(solidStateStack_.back());
+			//compare against the popped state so SetSolidified rebuilds when it differs.
+			bool restored = solidStateStack_.back();
+			solidStateStack_.back() = popped;
+			SetSolidified(restored);
 			return true;
 		}
 		else
@@ -41,9 +51,31 @@ public:
 
 	bool GetEffectivelySolidified() const;
 
-	//returns the rigid body associated with the group (could be null depending on current state)
-	NewtonRigidBody* GetRigidBody() { return node_->GetComponent<NewtonRigidBody>(); }
+	///wrapper group created by the PieceManager contraption LOD.  left out of contraption saves, kept in scene saves (see PieceManager::RestoreLodContraptions).
+	void SetLodGroup(bool lod) { lodGroup_ = lod; }
+	bool IsLodGroup() const { return lodGroup_; }
+
+	//returns the rigid body associated with the group (null unless the group is the top solid group of its branch - the body is kept but disabled otherwise)
+	NewtonRigidBody* GetRigidBody()
+	{
+		NewtonRigidBody* body = node_->GetComponent<NewtonRigidBody>();
+		return body && body->IsEnabled() ? body : nullptr;
+	}
+
+
 
+	///show the group as one merged model (or go back to per-piece models).  only the top solidified group of a branch should be merged.
+	void SetRenderMerged(bool merged);
+
+	bool GetRenderMerged() const;
+
+	///swap the piece box shapes for a merged set on the group node (or go back to the piece shapes).  only the top solidified group of a branch should be merged.
+	void SetCollisionMerged(bool merged);
+
+	bool GetCollisionMerged() const;
+
+	///tell the merged visual (if any) that pieces or materials may have changed.
+	void MarkRenderMergeDirty();
 
 
 	///Get all pieces part of this group. 
@@ -54,6 +86,9 @@ public:
 
 	void Update();
 
+	//slot in the PieceManager registry (maintained in OnNodeSet).
+	PieceRegistryHandle registryHandle_;
+
 protected:
 
 
@@ -62,6 +97,8 @@ protected:
 
 	ea::vector<bool> solidStateStack_;
 
+	bool lodGroup_ = false;
+
 
 	void HandleUpdate(StringHash event, VariantMap& eventData);
 	void HandleNodeAdded(StringHash event, VariantMap& eventData);
@@ -0,0 +1,588 @@
+#include "PieceUndoJournal.h"
+#include "PieceManager.h"
+#include "PieceContraptionFile.h"
+#include "Piece.h"
+#include "PiecePoint.h"
+#include "PiecePointRow.h"
+
+
+
+PieceUndoJournal::PieceUndoJournal(Context* context) : Component(context)
+{
+}
+
+void PieceUndoJournal::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PieceUndoJournal>();
+}
+
+void PieceUndoJournal::BeginOperation(const ea::string& name, const ea::vector<Piece*>& pieces)
+{
+	if (replaying_)
+		return;
+
+	if (depth_++ > 0)
+	{
+		AddToOperation(pieces);
+		return;
+	}
+
+	pending_ = Entry();
+	pending_.name_ = name;
+	pendingChunks_.Clear();
+	numPendingChunks_ = 0;
+	pendingIds_.clear();
+
+	AddToOperation(pieces);
+}
+
+void PieceUndoJournal::AddToOperation(const ea::vector<Piece*>& pieces)
+{
+	if (replaying_ || depth_ <= 0)
+		return;
+
+	ea::vector<Piece*> expanded;
+	ExpandAssemblies(pieces, expanded);
+
+	ea::vector<Piece*> newPieces;
+	for (Piece* piece : expanded)
+	{
+		unsigned id = GetPieceId(piece);
+		if (!pendingIds_.contains(id))
+		{
+			pendingIds_.insert(id);
+			pending_.pieceIds_.push_back(id);
+			newPieces.push_back(piece);
+		}
+	}
+
+	if (newPieces.empty())
+		return;
+
+	WriteChunk(newPieces, pendingChunks_);
+	numPendingChunks_++;
+}
+
+void PieceUndoJournal::AddCreatedToOperation(const ea::vector<Piece*>& pieces)
+{
+	if (replaying_ || depth_ <= 0)
+		return;
+
+	ea::vector<Piece*> expanded;
+	ExpandAssemblies(pieces, expanded);
+
+	//no undo state - undo removes them.
+	for (Piece* piece : expanded)
+	{
+		unsigned id = GetPieceId(piece);
+		if (!pendingIds_.contains(id))
+		{
+			pendingIds_.insert(id);
+			pending_.pieceIds_.push_back(id);
+		}
+	}
+}
+
+void PieceUndoJournal::EndOperation()
+{
+	if (replaying_ || depth_ <= 0)
+		return;
+
+	if (--depth_ > 0)
+		return;
+
+	if (pending_.pieceIds_.empty())
+		return;
+
+	pending_.before_.WriteVLE(numPendingChunks_);
+	pending_.before_.Write(pendingChunks_.GetData(), pendingChunks_.GetSize());
+	pendingChunks_.Clear();
+
+	ea::vector<Piece*> afterPieces;
+	for (unsigned id : pending_.pieceIds_)
+	{
+		if (Piece* piece = FindPiece(id))
+			afterPieces.push_back(piece);
+	}
+
+	pending_.after_.WriteVLE(afterPieces.empty() ? 0 : 1);
+	if (afterPieces.size())
+		WriteChunk(afterPieces, pending_.after_);
+
+
+	//a new operation drops the redo history.
+	DropEntriesFrom(cursor_);
+
+	memoryUse_ += pending_.before_.GetSize() + pending_.after_.GetSize();
+	entries_.push_back(ea::move(pending_));
+	pending_ = Entry();
+	cursor_ = entries_.size();
+
+	if (persistFile_)
+	{
+		VectorBuffer record;
+		record.WriteVLE(cursor_ - 1);
+		WriteEntry(entries_.back(), record);
+		AppendRecord(JournalRecord_Entry, record);
+	}
+
+	TrimToMemory();
+}
+
+bool PieceUndoJournal::Undo()
+{
+	if (!CanUndo() || depth_ > 0)
+		return false;
+
+	cursor_--;
+	ApplyState(entries_[cursor_].pieceIds_, entries_[cursor_].before_);
+	URHO3D_LOGINFO("PieceUndoJournal: undo " + entries_[cursor_].name_);
+
+	PersistCursor();
+	return true;
+}
+
+bool PieceUndoJournal::Redo()
+{
+	if (!CanRedo() || depth_ > 0)
+		return false;
+
+	ApplyState(entries_[cursor_].pieceIds_, entries_[cursor_].after_);
+	URHO3D_LOGINFO("PieceUndoJournal: redo " + entries_[cursor_].name_);
+	cursor_++;
+
+	PersistCursor();
+	return true;
+}
+
+void PieceUndoJournal::SetPersistFileName(const ea::string& fileName)
+{
+	persistFile_ = nullptr;
+	persistFileName_ = fileName;
+	if (persistFileName_.empty())
+		return;
+
+	if (GetSubsystem<FileSystem>()->FileExists(persistFileName_))
+	{
+		File file(context_, persistFileName_, FILE_READ);
+		if (!Load(file))
+			URHO3D_LOGWARNING("PieceUndoJournal: could not load " + persistFileName_);
+	}
+
+	//start the log over from what was loaded - this also drops a record a crash cut short.
+	WritePersisted();
+}
+
+bool PieceUndoJournal::Save(Serializer& dest) const
+{
+	bool success = dest.WriteFileID("PJRL");
+	for (unsigned i = 0; i < entries_.size(); i++)
+	{
+		VectorBuffer record;
+		record.WriteVLE(i);
+		WriteEntry(entries_[i], record);
+		success &= WriteRecord(dest, JournalRecord_Entry, record);
+	}
+
+	VectorBuffer record;
+	record.WriteVLE(cursor_);
+	success &= WriteRecord(dest, JournalRecord_Cursor, record);
+	return success;
+}
+
+bool PieceUndoJournal::Load(Deserializer& source)
+{
+	if (source.ReadFileID() != "PJRL")
+		return false;
+
+	Clear();
+
+	//replay the log.  a record that runs past the end was cut short while being written - everything before it stands.
+	unsigned cursor = 0;
+	while (!source.IsEof())
+	{
+		unsigned char type = source.ReadUByte();
+		unsigned size = source.ReadVLE();
+		if (source.GetPosition() + size > source.GetSize())
+			break;
+
+		VectorBuffer record(source, size);
+		if (type == JournalRecord_Entry)
+		{
+			Entry entry;
+			unsigned index = record.ReadVLE();
+			ReadEntry(record, entry);
+
+			DropEntriesFrom(index);
+			memoryUse_ += entry.before_.GetSize() + entry.after_.GetSize();
+			entries_.push_back(ea::move(entry));
+			cursor = entries_.size();
+		}
+		else if (type == JournalRecord_Cursor)
+		{
+			cursor = record.ReadVLE();
+		}
+		else if (type == JournalRecord_Trim)
+		{
+			unsigned numDropped = Min(record.ReadVLE(), (unsigned)entries_.size());
+			for (unsigned i = 0; i < numDropped; i++)
+				memoryUse_ -= entries_[i].before_.GetSize() + entries_[i].after_.GetSize();
+			entries_.erase(entries_.begin(), entries_.begin() + numDropped);
+			cursor = cursor > numDropped ? cursor - numDropped : 0;
+		}
+		else
+			break;
+	}
+	cursor_ = Min(cursor, (unsigned)entries_.size());
+
+	TrimToMemory();
+
+	if (persistFile_)
+		WritePersisted();
+	return true;
+}
+
+void PieceUndoJournal::Clear()
+{
+	entries_.clear();
+	cursor_ = 0;
+	memoryUse_ = 0;
+}
+
+unsigned PieceUndoJournal::GetPieceId(Piece* piece)
+{
+	if (!piece->journalId_)
+	{
+		//ids may have come in with a loaded scene - never hand out one that is in use.
+		if (nextId_ == 1)
+			RebuildIdMap();
+
+		SetPieceId(piece, nextId_);
+	}
+	else if (!piecesById_.contains(piece->journalId_))
+	{
+		piecesById_.insert_or_assign(piece->journalId_, WeakPtr<Piece>(piece));
+	}
+	return piece->journalId_;
+}
+
+Piece* PieceUndoJournal::FindPiece(unsigned id)
+{
+	auto it = piecesById_.find(id);
+	if (it == piecesById_.end())
+	{
+		RebuildIdMap();
+		it = piecesById_.find(id);
+		if (it == piecesById_.end())
+			return nullptr;
+	}
+	return it->second;
+}
+
+void PieceUndoJournal::ExpandAssemblies(const ea::vector<Piece*>& pieces, ea::vector<Piece*>& expanded)
+{
+	for (Piece* piece : pieces)
+	{
+		if (!piece)
+			continue;
+
+		ea::vector<Piece*> members;
+		piece->GetAssemblyPieces(members, true);
+		for (Piece* member : members)
+		{
+			if (!expanded.contains(member))
+				expanded.push_back(member);
+		}
+	}
+}
+
+void PieceUndoJournal::WriteChunk(const ea::vector<Piece*>& pieces, Serializer& dest)
+{
+	PieceManager* pieceManager = GetScene()->GetComponent<PieceManager>();
+
+	ContraptionFileData data;
+	pieceManager->CaptureContraption(data, pieces, false);
+	data.Write(dest);
+
+	for (Piece* piece : pieces)
+		dest.WriteVLE(GetPieceId(piece));
+
+	//attachments to pieces outside the chunk - re-made by journal id when the chunk is applied.
+	VectorBuffer externals;
+	unsigned numExternals = 0;
+	for (unsigned i = 0; i < pieces.size(); i++)
+	{
+		ea::vector<PiecePointRow*> rows;
+		pieces[i]->GetPointRows(rows);
+		for (unsigned r = 0; r < rows.size(); r++)
+		{
+			for (const PiecePointRow::RowAttachement& attachment : rows[r]->rowAttachements_)
+			{
+				PiecePointRow* otherRow = attachment.rowOther_;
+				Piece* otherPiece = otherRow ? otherRow->GetPiece() : nullptr;
+				if (!otherPiece || pieces.contains(otherPiece) || !attachment.point || !attachment.pointOther_)
+					continue;
+
+				if (rows[r]->GetPointIndex(attachment.point) == M_MAX_UNSIGNED || otherRow->GetPointIndex(attachment.pointOther_) == M_MAX_UNSIGNED)
+					continue;
+
+				ea::vector<PiecePointRow*> otherRows;
+				otherPiece->GetPointRows(otherRows);
+
+				externals.WriteVLE(i);
+				externals.WriteVLE(r);
+				externals.WriteVLE(rows[r]->GetPointIndex(attachment.point));
+				externals.WriteVLE(GetPieceId(otherPiece));
+				externals.WriteVLE(otherRows.index_of(otherRow));
+				externals.WriteVLE(otherRow->GetPointIndex(attachment.pointOther_));
+				numExternals++;
+			}
+		}
+	}
+
+	dest.WriteVLE(numExternals);
+	dest.Write(externals.GetData(), externals.GetSize());
+}
+
+void PieceUndoJournal::ApplyState(const ea::vector<unsigned>& pieceIds, const VectorBuffer& state)
+{
+	PieceManager* pieceManager = GetScene()->GetComponent<PieceManager>();
+	replaying_ = true;
+	pieceManager->SuspendNodeRebuilds();
+
+	//groups the removed pieces leave may end up empty - they are cleaned and rebuilt below, nothing else in the scene is.
+	ea::vector<WeakPtr<Node>> oldParents;
+	for (unsigned id : pieceIds)
+	{
+		if (Piece* piece = FindPiece(id))
+		{
+			Node* parent = piece->GetNode()->GetParent();
+			if (parent && parent != GetScene())
+				oldParents.push_back(WeakPtr<Node>(parent));
+
+			piece->DetachAll();
+			piece->GetNode()->Remove();
+		}
+	}
+
+
+	struct External {
+		WeakPtr<Piece> piece_;
+		unsigned row_;
+		unsigned point_;
+		unsigned otherId_;
+		unsigned otherRow_;
+		unsigned otherPoint_;
+	};
+	ea::vector<External> externals;
+	ea::vector<WeakPtr<Piece>> restored;
+
+	MemoryBuffer source(state.GetData(), state.GetSize());
+	unsigned numChunks = source.ReadVLE();
+	for (unsigned c = 0; c < numChunks; c++)
+	{
+		ContraptionFileData data;
+		if (!data.Read(source))
+		{
+			URHO3D_LOGWARNING("PieceUndoJournal: corrupt journal entry");
+			break;
+		}
+
+		ContraptionBuilder builder(pieceManager, &data);
+		ea::vector<unsigned> indexes;
+		for (unsigned i = 0; i < data.pieces_.size(); i++)
+		{
+			unsigned id = source.ReadVLE();
+			if (builder.SpawnPiece(i, false))
+			{
+				SetPieceId(builder.GetPiece(i), id);
+				restored.push_back(WeakPtr<Piece>(builder.GetPiece(i)));
+				indexes.push_back(i);
+			}
+		}
+
+		for (unsigned i = 0; i < data.attachments_.size(); i++)
+			builder.Attach(i);
+
+		builder.FinishPieces(indexes);
+
+		unsigned numExternals = source.ReadVLE();
+		for (unsigned i = 0; i < numExternals; i++)
+		{
+			External external;
+			unsigned local = source.ReadVLE();
+			external.piece_ = local < data.pieces_.size() ? builder.GetPiece(local) : nullptr;
+			external.row_ = source.ReadVLE();
+			external.point_ = source.ReadVLE();
+			external.otherId_ = source.ReadVLE();
+			external.otherRow_ = source.ReadVLE();
+			external.otherPoint_ = source.ReadVLE();
+			externals.push_back(external);
+		}
+	}
+
+
+	//every chunk is in place - now connect to the rest of the scene.  edges between chunks show up twice.
+	for (const External& external : externals)
+	{
+		Piece* piece = external.piece_;
+		Piece* otherPiece = FindPiece(external.otherId_);
+		if (!piece || !otherPiece)
+			continue;
+
+		ea::vector<PiecePointRow*> rows;
+		ea::vector<PiecePointRow*> otherRows;
+		piece->GetPointRows(rows);
+		otherPiece->GetPointRows(otherRows);
+		if (external.row_ >= rows.size() || external.otherRow_ >= otherRows.size())
+			continue;
+
+		PiecePointRow* row = rows[external.row_];
+		PiecePointRow* otherRow = otherRows[external.otherRow_];
+		if (external.point_ >= row->GetPoints().size() || external.otherPoint_ >= otherRow->GetPoints().size())
+			continue;
+
+		if (!row->AttachedToRow(otherRow) && !otherRow->AttachedToRow(row))
+			PiecePointRow::AttachRows(row, otherRow, row->GetPoints()[external.point_], otherRow->GetPoints()[external.otherPoint_]);
+	}
+
+	for (Piece* piece : restored)
+	{
+		if (piece && !piece->GetPieceGroup())
+			pieceManager->FormSolidGroupsOnContraption(piece);
+	}
+
+	for (Node* oldParent : oldParents)
+	{
+		if (oldParent)
+			pieceManager->CleanGroups(oldParent);
+	}
+
+	ea::vector<Node*> changedNodes;
+	for (Node* oldParent : oldParents)
+	{
+		if (oldParent)
+			changedNodes.push_back(oldParent);
+	}
+	for (Piece* piece : restored)
+	{
+		if (piece)
+			changedNodes.push_back(piece->GetNode());
+	}
+	pieceManager->ResumeNodeRebuilds();
+	pieceManager->RebuildSolidifiesBranches(changedNodes);
+
+	replaying_ = false;
+}
+
+void PieceUndoJournal::SetPieceId(Piece* piece, unsigned id)
+{
+	piece->journalId_ = id;
+	piecesById_.insert_or_assign(id, WeakPtr<Piece>(piece));
+	nextId_ = Max(nextId_, id + 1);
+}
+
+void PieceUndoJournal::RebuildIdMap()
+{
+	piecesById_.clear();
+	for (Piece* piece : GetScene()->GetComponent<PieceManager>()->GetAllPieces())
+	{
+		if (piece->journalId_)
+		{
+			piecesById_.insert_or_assign(piece->journalId_, WeakPtr<Piece>(piece));
+			nextId_ = Max(nextId_, piece->journalId_ + 1);
+		}
+	}
+}
+
+void PieceUndoJournal::DropEntriesFrom(unsigned index)
+{
+	for (unsigned i = index; i < entries_.size(); i++)
+		memoryUse_ -= entries_[i].before_.GetSize() + entries_[i].after_.GetSize();
+	if (index < entries_.size())
+		entries_.resize(index);
+}
+
+void PieceUndoJournal::TrimToMemory()
+{
+	unsigned numDropped = 0;
+	while (memoryUse_ > maxMemory_ && numDropped < entries_.size())
+	{
+		memoryUse_ -= entries_[numDropped].before_.GetSize() + entries_[numDropped].after_.GetSize();
+		numDropped++;
+	}
+
+	if (numDropped)
+	{
+		entries_.erase(entries_.begin(), entries_.begin() + numDropped);
+		cursor_ = cursor_ > numDropped ? cursor_ - numDropped : 0;
+
+		if (persistFile_)
+		{
+			VectorBuffer record;
+			record.WriteVLE(numDropped);
+			AppendRecord(JournalRecord_Trim, record);
+		}
+	}
+}
+
+void PieceUndoJournal::WriteEntry(const Entry& entry, Serializer& dest)
+{
+	dest.WriteString(entry.name_);
+	dest.WriteVLE(entry.pieceIds_.size());
+	for (unsigned id : entry.pieceIds_)
+		dest.WriteVLE(id);
+	dest.WriteBuffer(entry.before_.GetBuffer());
+	dest.WriteBuffer(entry.after_.GetBuffer());
+}
+
+void PieceUndoJournal::ReadEntry(Deserializer& source, Entry& entry)
+{
+	entry.name_ = source.ReadString();
+	entry.pieceIds_.resize(source.ReadVLE());
+	for (unsigned& id : entry.pieceIds_)
+		id = source.ReadVLE();
+	entry.before_.SetData(source.ReadBuffer());
+	entry.after_.SetData(source.ReadBuffer());
+}
+
+bool PieceUndoJournal::WriteRecord(Serializer& dest, JournalRecord type, const VectorBuffer& record)
+{
+	bool success = dest.WriteUByte(type);
+	success &= dest.WriteVLE(record.GetSize());
+	success &= dest.Write(record.GetData(), record.GetSize()) == record.GetSize();
+	return success;
+}
+
+void PieceUndoJournal::AppendRecord(JournalRecord type, const VectorBuffer& record)
+{
+	if (!WriteRecord(*persistFile_, type, record))
+		URHO3D_LOGWARNING("PieceUndoJournal: could not write " + persistFileName_);
+	persistFile_->Flush();
+
+	//records of dropped entries pile up in the log - rewrite it once it is mostly dead weight.
+	if (persistFile_->GetSize() > 2 * memoryUse_ + 64 * 1024)
+		WritePersisted();
+}
+
+void PieceUndoJournal::PersistCursor()
+{
+	if (!persistFile_)
+		return;
+
+	VectorBuffer record;
+	record.WriteVLE(cursor_);
+	AppendRecord(JournalRecord_Cursor, record);
+}
+
+void PieceUndoJournal::WritePersisted()
+{
+	persistFile_ = new File(context_, persistFileName_, FILE_WRITE);
+	if (!persistFile_->IsOpen() || !Save(*persistFile_))
+	{
+		URHO3D_LOGWARNING("PieceUndoJournal: could not write " + persistFileName_);
+		persistFile_ = nullptr;
+		return;
+	}
+	persistFile_->Flush();
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+class Piece;
+
+//undo/redo of piece operations (attach, detach, move, remove, duplicate) as compact deltas.
+//an operation records the state of only the pieces it touches - before when it opens, after when it closes.
+//undo/redo removes those pieces and re-spawns them from the recorded state, re-attaching them to untouched pieces by journal id.
+//the journal is bounded by memory and can optionally be persisted to a file.  attach to the scene node (see PieceManager::GetUndoJournal).
+class PieceUndoJournal : public Component
+{
+	URHO3D_OBJECT(PieceUndoJournal, Component);
+
+public:
+
+	PieceUndoJournal(Context* context);
+
+	static void RegisterObject(Context* context);
+
+	///open an operation.  the current state of pieces is its undo state.  nested calls join the open operation.
+	void BeginOperation(const ea::string& name, const ea::vector<Piece*>& pieces);
+
+	///add pieces to the open operation.  their current state is recorded as undo state unless they were already part of it.
+	void AddToOperation(const ea::vector<Piece*>& pieces);
+
+	///add pieces created by the open operation.  they are removed on undo.
+	void AddCreatedToOperation(const ea::vector<Piece*>& pieces);
+
+	///close the operation and record the redo state of everything it touched.
+	void EndOperation();
+
+	bool Undo();
+	bool Redo();
+
+	bool CanUndo() const { return cursor_ > 0; }
+	bool CanRedo() const { return cursor_ < entries_.size(); }
+
+	///name of the operation Undo() would revert.
+	ea::string GetUndoName() const { return CanUndo() ? entries_[cursor_ - 1].name_ : ea::string(); }
+
+	///true while undo/redo is re-spawning pieces.  operations opened meanwhile are ignored.
+	bool IsReplaying() const { return replaying_; }
+
+	///oldest operations are dropped once their recorded deltas exceed this many bytes.
+	void SetMaxMemory(unsigned bytes) { maxMemory_ = bytes; TrimToMemory(); }
+	unsigned GetMaxMemory() const { return maxMemory_; }
+	unsigned GetMemoryUse() const { return memoryUse_; }
+
+	///when set the journal is loaded from the file now and every change after is appended to it as one small record.
+	///the file is only rewritten whole when it is opened and when records of dropped operations make up most of it.  journal ids are saved with pieces (AM_FILE).
+	void SetPersistFileName(const ea::string& fileName);
+
+	bool Save(Serializer& dest) const;
+	bool Load(Deserializer& source);
+
+	void Clear();
+
+	///stable id of a piece across undo/redo.  assigned on first use.
+	unsigned GetPieceId(Piece* piece);
+
+	Piece* FindPiece(unsigned id);
+
+protected:
+
+	//records of the journal file.  the file is a log - loading replays them in order.
+	enum JournalRecord : unsigned char {
+		JournalRecord_Entry = 'E',//index, entry - drops the entries from index on and appends the entry.
+		JournalRecord_Cursor = 'C',//cursor
+		JournalRecord_Trim = 'T'//number of oldest entries dropped
+	};
+
+	struct Entry {
+		ea::string name_;
+		ea::vector<unsigned> pieceIds_;
+		VectorBuffer before_;
+		VectorBuffer after_;
+	};
+
+	//all assembly members of the given pieces (assemblies are spawned as one).
+	void ExpandAssemblies(const ea::vector<Piece*>& pieces, ea::vector<Piece*>& expanded);
+
+	//writes one state chunk: the pieces, their journal ids and their attachments to pieces outside the chunk.
+	void WriteChunk(const ea::vector<Piece*>& pieces, Serializer& dest);
+
+	//remove the current pieces with the given ids and re-spawn them from a recorded state.
+	void ApplyState(const ea::vector<unsigned>& pieceIds, const VectorBuffer& state);
+
+	void SetPieceId(Piece* piece, unsigned id);
+
+	void RebuildIdMap();
+
+	void DropEntriesFrom(unsigned index);
+
+	void TrimToMemory();
+
+	static void WriteEntry(const Entry& entry, Serializer& dest);
+	static void ReadEntry(Deserializer& source, Entry& entry);
+	static bool WriteRecord(Serializer& dest, JournalRecord type, const VectorBuffer& record);
+
+	//append to the open journal file.
+	void AppendRecord(JournalRecord type, const VectorBuffer& record);
+
+	void PersistCursor();
+
+	//write the whole journal as a fresh log and keep the file open for appending.
+	void WritePersisted();
+
+	ea::vector<Entry> entries_;
+	unsigned cursor_ = 0;//entries before the cursor are applied.
+
+	//open operation
+	int depth_ = 0;
+	Entry pending_;
+	VectorBuffer pendingChunks_;
+	unsigned numPendingChunks_ = 0;
+	ea::hash_set<unsigned> pendingIds_;
+
+	bool replaying_ = false;
+
+	unsigned maxMemory_ = 4 * 1024 * 1024;
+	unsigned memoryUse_ = 0;
+
+	ea::string persistFileName_;
+	SharedPtr<File> persistFile_;
+
+	unsigned nextId_ = 1;
+	ea::hash_map<unsigned, WeakPtr<Piece>> piecesById_;
+};
@@ -0,0 +1,48 @@
+#include "StepTimingHistogram.h"
+
+
+
+void StepTimingHistogram::Add(long long usec)
+{
+	unsigned bucket = 0;
+	while (bucket < NUM_BUCKETS - 1 && (1ll << bucket) <= usec)
+		bucket++;
+
+	buckets_[bucket]++;
+	count_++;
+	totalUSec_ += usec;
+	maxUSec_ = Max(maxUSec_, usec);
+}
+
+void StepTimingHistogram::Reset()
+{
+	*this = StepTimingHistogram();
+}
+
+long long StepTimingHistogram::GetPercentileUSec(float fraction) const
+{
+	unsigned threshold = unsigned(Ceil(fraction * count_));
+	unsigned sum = 0;
+	for (unsigned i = 0; i < NUM_BUCKETS; i++)
+	{
+		sum += buckets_[i];
+		if (sum >= threshold && sum)
+			return 1ll << i;
+	}
+	return maxUSec_;
+}
+
+ea::string StepTimingHistogram::ToString(const ea::string& label) const
+{
+	ea::string text = label + ": " + ea::to_string(count_) + " steps, avg " + ea::to_string(count_ ? totalUSec_ / count_ : 0)
+		+ " us, p99 < " + ea::to_string(GetPercentileUSec(0.99f)) + " us, max " + ea::to_string(maxUSec_) + " us\n";
+
+	for (unsigned i = 0; i < NUM_BUCKETS; i++)
+	{
+		if (!buckets_[i])
+			continue;
+
+		text += "  < " + ea::to_string(1ll << i) + " us: " + ea::to_string(buckets_[i]) + "\n";
+	}
+	return text;
+}
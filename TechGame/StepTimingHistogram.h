@@ -0,0 +1,33 @@
+#pragma once
+#include <Urho3D/Urho3DAll.h>
+
+
+//histogram of step durations in power of two microsecond buckets (bucket i holds [2^(i-1), 2^i) us, bucket 0 holds < 1 us).
+class StepTimingHistogram
+{
+public:
+
+	static const unsigned NUM_BUCKETS = 24;
+
+	void Add(long long usec);
+
+	void Reset();
+
+	unsigned GetCount() const { return count_; }
+	long long GetTotalUSec() const { return totalUSec_; }
+	long long GetMaxUSec() const { return maxUSec_; }
+	unsigned GetBucketCount(unsigned bucket) const { return buckets_[bucket]; }
+
+	///upper bound (us) of the bucket the given fraction of samples falls under.
+	long long GetPercentileUSec(float fraction) const;
+
+	///one line per non-empty bucket.
+	ea::string ToString(const ea::string& label) const;
+
+protected:
+
+	unsigned buckets_[NUM_BUCKETS] = {};
+	unsigned count_ = 0;
+	long long totalUSec_ = 0;
+	long long maxUSec_ = 0;
+};
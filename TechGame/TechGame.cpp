@@ -19,6 +19,20 @@
 #include "Urho3D/SystemUI/Console.h"
 #include "Urho3D/SystemUI/DebugHud.h"
 #include "PieceGear.h"
+#include "PieceAimQuery.h"
+#include "PiecePointIndicatorRenderer.h"
+#include "PieceGroupMergedVisual.h"
+#include "PieceGroupMergedCollision.h"
+#include "PieceCatalog.h"
+#include "PieceResourcePreloader.h"
+#include "ContraptionStreamLoader.h"
+#include "ContraptionAutoSave.h"
+#include "PieceUndoJournal.h"
+#include "PhysicsReplay.h"
+#include "PhysicsSolverGovernor.h"
+#include "PhysicsContactStream.h"
+#include "ImpactAudio.h"
+#include "HeadlessSimulation.h"
 #include "ColorPallet.h"
 #include "AppVersion.h"
 
@@ -38,8 +52,29 @@ void TechGame::Setup()
 	engineParameters_[EP_RESOURCE_PREFIX_PATHS] = ".";
 #endif
 	
+	//offline build step for the binary piece catalog - runs without a window and exits when done.
+	if (GetArguments().contains("-BuildPieceCatalog"))
+	{
+		buildPieceCatalog_ = true;
+		engineParameters_[EP_HEADLESS] = true;
+	}
+
+	//benchmark run - no window, renderer or audio.
+#ifdef TECHGAME_HEADLESS
+	headlessSimulation_ = true;
+#endif
+	if (GetArguments().contains("-Headless"))
+		headlessSimulation_ = true;
+
+	if (headlessSimulation_)
+	{
+		engineParameters_[EP_HEADLESS] = true;
+		engineParameters_[EP_SOUND] = false;
+	}
 
 	context_->RegisterSubsystem<AppVersion>()->SetVersion(0, 0, 3);
+	context_->RegisterSubsystem<PieceCatalog>();
+	context_->RegisterSubsystem<PieceResourcePreloader>();
 	Character::RegisterObject(context_);
 	ManipulationTool::RegisterObject(context_);
 
@@ -50,6 +85,17 @@ void TechGame::Setup()
 	PiecePoint::RegisterObject(context_);
 	PiecePointRow::RegisterObject(context_);
 	PieceGear::RegisterObject(context_);
+	PieceAimQuery::RegisterObject(context_);
+	PiecePointIndicatorRenderer::RegisterObject(context_);
+	PieceGroupMergedVisual::RegisterObject(context_);
+	PieceGroupMergedCollision::RegisterObject(context_);
+	ContraptionStreamLoader::RegisterObject(context_);
+	ContraptionAutoSave::RegisterObject(context_);
+	PieceUndoJournal::RegisterObject(context_);
+	PhysicsReplayRecorder::RegisterObject(context_);
+	PhysicsSolverGovernor::RegisterObject(context_);
+	PhysicsContactStream::RegisterObject(context_);
+	ImpactAudio::RegisterObject(context_);
 	ColorPallet::RegisterObject(context_);
 	ColorPalletManager::RegisterObject(context_);
 
@@ -61,6 +107,30 @@ void TechGame::Setup()
 
 void TechGame::Start()
 {
+	if (buildPieceCatalog_)
+	{
+		ea::string fileName = GetSubsystem<ResourceCache>()->GetResourceDirs().front() + PIECECATALOG_FILENAME;
+		PieceCatalog::Build(context_, fileName);
+		engine_->Exit();
+		return;
+	}
+
+	//spawn pieces from the precomputed catalog when one has been built.  missing catalog falls back to procedural creation.
+	GetSubsystem<PieceCatalog>()->Load(GetSubsystem<ResourceCache>()->GetResourceFileName(PIECECATALOG_FILENAME));
+
+	if (headlessSimulation_)
+	{
+		SharedPtr<HeadlessSimulation> simulation(new HeadlessSimulation(context_));
+		simulation->ParseArguments(GetArguments());
+		if (!simulation->Run())
+			ErrorExit("HeadlessSimulation failed");
+		else
+			engine_->Exit();
+		return;
+	}
+
+	//warm the resource cache in the background while the rest of startup runs.
+	GetSubsystem<PieceResourcePreloader>()->Start();
 
 	GetSubsystem<Engine>()->SetMaxFps(200);
 	GetSubsystem<Engine>()->SetMinFps(90);
@@ -221,8 +291,7 @@ void TechGame::SubscribeToEvents()
 	SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(TechGame, HandlePostRenderUpdate));
 
 
-	SubscribeToEvent(E_NEWTON_NODECOLLISIONSTART, URHO3D_HANDLER(TechGame, HandleNodeCollisionStart));
-	SubscribeToEvent(E_NEWTON_NODECOLLISIONEND, URHO3D_HANDLER(TechGame, HandleNodeCollisionEnd));
+	//no per body collision events here - impacts come from the scene's PhysicsContactStream (see ImpactAudio).
 
 
 
@@ -323,6 +392,15 @@ void TechGame::UpdateUIInput(float timestep)
 		}
 	}
 
+	//undo / redo
+	if (input->GetKeyPress(KEY_Z) && !manipTool->IsGathering() && !manipTool->IsDragging())
+	{
+		if (input->GetKeyDown(KEY_SHIFT))
+			scene_->GetComponent<PieceManager>()->GetUndoJournal()->Redo();
+		else
+			scene_->GetComponent<PieceManager>()->GetUndoJournal()->Undo();
+	}
+
 	if (input->GetKeyPress(KEY_M)) {
 		//toggle move modes
 		ManipulationTool::MoveMode curMode = character_->rightHandNode_->GetComponent<ManipulationTool>()->GetMoveMode();
@@ -410,7 +488,13 @@ void TechGame::DefaultCreateScene()
 	NewtonPhysicsWorld* physicsWorld = scene_->CreateComponent<NewtonPhysicsWorld>();	
 	physicsWorld->SetGravity(Vector3(0, -9.81, 0));
 	physicsWorld->SetDebugScale(0.25f);
-	//physicsWorld->SetIterationCount(8);
+
+	//iterations and substeps are owned by the governor - full quality until the step time runs over budget.
+	scene_->CreateComponent<PhysicsSolverGovernor>();
+
+	//impacts for sound and damage come from the stream - one filtered array per step.
+	scene_->CreateComponent<PhysicsContactStream>();
+	scene_->CreateComponent<ImpactAudio>();
 	
 
 	context_->RegisterSubsystem<VisualDebugger>();
@@ -421,6 +505,9 @@ void TechGame::DefaultCreateScene()
 	character_->ResolveNodes();
 	ResolveTools(character_);
 
+	scene_->GetComponent<PieceManager>()->SetLodViewer(character_->headNode_);
+	scene_->GetComponent<PieceManager>()->SetScheduleCamera(character_->headNode_->GetComponent<Camera>());
+
 	bool vrInitialized = false;// vr->InitializeVR(character_->GetNode());
 
 	character_->SetIsVRCharacter(vrInitialized);
@@ -626,7 +713,7 @@ void TechGame::SetupSceneAfterLoad()
 	character_->ResolveNodes();
 	ResolveTools(character_);
 
-
+	scene_->GetComponent<PieceManager>()->SetupAfterSceneLoad();
 
 	SetupViewport();
 }
@@ -660,7 +747,104 @@ void TechGame::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 
 	ui::Begin("Utils");
 
-	if (ui::Button("Save Scene..."))
+	PieceResourcePreloader* preloader = GetSubsystem<PieceResourcePreloader>();
+	if (!preloader->IsFinished())
+	{
+		ui::Text("Loading piece resources...");
+		ui::ProgressBar(preloader->GetProgress());
+	}
+
+	if (ui::Button("Save Contraption..."))
+	{
+		if (scene_->GetComponent<PieceManager>()->SaveContraptionFile("contraptionSave.bin"))
+			URHO3D_LOGINFO("contraptionSave.bin Sucessfully Saved.");
+	}
+
+	if (ui::Button("Load Contraption..."))
+	{
+		scene_->GetComponent<PieceManager>()->RemoveAllPieces();
+
+		//streamed over several frames so big builds do not stall the app.
+		ContraptionStreamLoader* loader = scene_->GetOrCreateComponent<ContraptionStreamLoader>();
+		loader->SetTemporary(true);
+		loader->Start("contraptionSave.bin");
+	}
+
+	ContraptionAutoSave* autoSave = scene_->GetComponent<ContraptionAutoSave>();
+	bool autoSaveEnabled = autoSave && autoSave->IsEnabled();
+	if (ui::Checkbox("Autosave", &autoSaveEnabled))
+	{
+		if (!autoSave)
+		{
+			autoSave = scene_->CreateComponent<ContraptionAutoSave>();
+			autoSave->SetTemporary(true);
+		}
+		autoSave->SetEnabled(autoSaveEnabled);
+	}
+
+	if (ui::Button("Load Autosave..."))
+	{
+		scene_->GetComponent<PieceManager>()->RemoveAllPieces();
+
+		ContraptionStreamLoader* loader = scene_->GetOrCreateComponent<ContraptionStreamLoader>();
+		loader->SetTemporary(true);
+		loader->Start(CONTRAPTION_AUTOSAVE_FILENAME);
+	}
+
+	bool fixedStepUpdates = scene_->GetComponent<PieceManager>()->GetFixedStepUpdates();
+	if (ui::Checkbox("Fixed Step Piece Updates", &fixedStepUpdates))
+		scene_->GetComponent<PieceManager>()->SetFixedStepUpdates(fixedStepUpdates);
+
+	bool lodEnabled = scene_->GetComponent<PieceManager>()->GetLodEnabled();
+	if (ui::Checkbox("Contraption LOD", &lodEnabled))
+		scene_->GetComponent<PieceManager>()->SetLodEnabled(lodEnabled);
+	ui::SameLine();
+	ui::Text("(%u solidified)", scene_->GetComponent<PieceManager>()->GetNumLodContraptions());
+
+	bool rateScheduling = scene_->GetComponent<PieceManager>()->GetRateSchedulingEnabled();
+	if (ui::Checkbox("Contraption Rate Scheduling", &rateScheduling))
+		scene_->GetComponent<PieceManager>()->SetRateSchedulingEnabled(rateScheduling);
+	ui::SameLine();
+	ui::Text("(%u reduced, %u frozen)", scene_->GetComponent<PieceManager>()->GetNumReducedRateContraptions(), scene_->GetComponent<PieceManager>()->GetNumFrozenRateContraptions());
+
+	if (PhysicsSolverGovernor* governor = scene_->GetComponent<PhysicsSolverGovernor>())
+	{
+		bool governorEnabled = governor->IsEnabled();
+		if (ui::Checkbox("Solver Governor", &governorEnabled))
+			governor->SetEnabled(governorEnabled);
+		ui::SameLine();
+		ui::Text("(%d iterations, %d substeps, %lld us)", governor->GetIterations(), governor->GetSubSteps(), governor->GetAverageUSec());
+	}
+
+	if (PhysicsContactStream* contactStream = scene_->GetComponent<PhysicsContactStream>())
+		ui::Text("Impacts: %u of %u contacts", contactStream->GetNumContactsAccepted(), contactStream->GetNumContactsSeen());
+	if (ImpactAudio* impactAudio = scene_->GetComponent<ImpactAudio>())
+		ui::Text("Impact voices: %u of %u playing (%u dropped)", impactAudio->GetNumPlaying(), impactAudio->GetNumVoices(), impactAudio->GetNumDropped());
+
+	PhysicsReplayRecorder* replayRecorder = scene_->GetComponent<PhysicsReplayRecorder>();
+	bool replayRecording = replayRecorder && replayRecorder->IsRecording();
+	if (ui::Checkbox("Record Replay", &replayRecording))
+	{
+		if (!replayRecorder)
+		{
+			replayRecorder = scene_->CreateComponent<PhysicsReplayRecorder>();
+			replayRecorder->SetTemporary(true);
+		}
+		replayRecorder->SetRecording(replayRecording);
+	}
+
+	if (replayRecorder && ui::Button("Dump Replay..."))
+	{
+		if (replayRecorder->DumpFile("replay.prp"))
+			URHO3D_LOGINFO("replay.prp Sucessfully Saved.");
+	}
+
+	ContraptionStreamLoader* contraptionLoader = scene_->GetComponent<ContraptionStreamLoader>();
+	if (contraptionLoader && contraptionLoader->IsLoading())
+		ui::ProgressBar(contraptionLoader->GetProgress());
+
+	//full scene xml - kept as a human readable export.
+	if (ui::Button("Export Scene XML..."))
 	{
 		ea::string filePath = "sceneSave.xml";
 
@@ -668,13 +852,16 @@ void TechGame::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 
 		SharedPtr<File> outFile = SharedPtr<File>(new File(context_, "sceneSave.xml", Urho3D::FILE_WRITE));
 
+		PieceManager* pieceManager = scene_->GetComponent<PieceManager>();
+		pieceManager->BeginSceneSave();
 		bool saveSuccess = scene_->SaveXML(*outFile);
+		pieceManager->EndSceneSave();
 
 		if (saveSuccess)
 			URHO3D_LOGINFO(outFile->GetName() + " Sucessfully Saved.");
 	}
 
-	if (ui::Button("Load Scene..."))
+	if (ui::Button("Import Scene XML..."))
 	{
 		ea::string filePath = "sceneSave.xml";
 
@@ -720,6 +907,14 @@ void TechGame::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 
 	ui::Checkbox("DynamicRodDetachment", &scene_->GetComponent<PieceManager>()->enableDynamicRodDetach_);
 
+	bool mergeGroupVisuals = scene_->GetComponent<PieceManager>()->GetRenderMergeSolidGroups();
+	if (ui::Checkbox("MergeSolidGroupVisuals", &mergeGroupVisuals))
+		scene_->GetComponent<PieceManager>()->SetRenderMergeSolidGroups(mergeGroupVisuals);
+
+	bool mergeGroupCollision = scene_->GetComponent<PieceManager>()->GetMergeSolidGroupCollision();
+	if (ui::Checkbox("MergeSolidGroupCollision", &mergeGroupCollision))
+		scene_->GetComponent<PieceManager>()->SetMergeSolidGroupCollision(mergeGroupCollision);
+
 
 	if (scene_->GetComponent<NewtonPhysicsWorld>()->GetRemainingSteps() == -1) {
 		if (ui::Button("Pause Physics Simulation")) {
@@ -797,8 +992,7 @@ void TechGame::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventDat
 			
 
 
-			ea::vector<PiecePoint*> components;
-			scene_->GetDerivedComponents<PiecePoint>(components, true);
+			const ea::vector<PiecePoint*>& components = scene_->GetComponent<PieceManager>()->GetAllPiecePoints();
 
 			for (PiecePoint* comp : components)
 			{
@@ -809,8 +1003,7 @@ void TechGame::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventDat
 			ui::Checkbox("PiecePointRows", &drawDebugPiecePointRows);
 			if (drawDebugPiecePointRows) {
 
-				ea::vector<PiecePointRow*> components;
-				scene_->GetDerivedComponents<PiecePointRow>(components, true);
+				const ea::vector<PiecePointRow*>& components = scene_->GetComponent<PieceManager>()->GetAllPiecePointRows();
 
 				for (PiecePointRow* comp : components)
 				{
@@ -826,8 +1019,7 @@ void TechGame::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventDat
 		if (drawDebugPieceGears)
 		{
 
-			ea::vector<PieceGear*> components;
-			scene_->GetDerivedComponents<PieceGear>(components, true);
+			const ea::vector<PieceGear*>& components = scene_->GetComponent<PieceManager>()->GetAllPieceGears();
 
 			for (PieceGear* comp : components)
 			{
@@ -843,8 +1035,7 @@ void TechGame::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventDat
 
 		ui::Checkbox("PieceGroups", &drawDebugPieceGroups);
 		if (drawDebugPieceGroups) {
-			ea::vector<PieceSolidificationGroup*> groups;
-			scene_->GetDerivedComponents<PieceSolidificationGroup>(groups, true);
+			const ea::vector<PieceSolidificationGroup*>& groups = scene_->GetComponent<PieceManager>()->GetAllSolidGroups();
 
 			for (PieceSolidificationGroup* comp : groups)
 			{
@@ -943,62 +1134,3 @@ void TechGame::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventDat
 	
 }
 
-void TechGame::HandleNodeCollisionStart(StringHash eventType, VariantMap& eventData)
-{
-	NewtonRigidBody* bodyA = static_cast<NewtonRigidBody*>(eventData[NewtonPhysicsCollisionStart::P_BODYA].GetPtr());
-	NewtonRigidBody* bodyB = static_cast<NewtonRigidBody*>(eventData[NewtonPhysicsCollisionStart::P_BODYB].GetPtr());
-
-	//NewtonRigidBodyContactEntry* contactData = static_cast<NewtonRigidBodyContactEntry*>(eventData[NewtonPhysicsCollisionStart::P_CONTACT_DATA].GetPtr());
-
-	//float largestForce = 0.0f;
-	//Vector3 position;
-	//for (int i = 0; i < contactData->numContacts; i++) {
-	//	if (contactData->contactForces[i].Length() > largestForce) {
-	//		largestForce = contactData->contactForces[i].Length();
-	//		position = contactData->contactPositions[i];
-	//	}
-	//}
-
-	//Vector3 velA = bodyA->GetLinearVelocity();
-	//Vector3 velB = bodyB->GetLinearVelocity();
-	//float impactVelocity = velA.Length() + velB.Length();
-
-	////URHO3D_LOGINFO(String(impactVelocity));
-
-	//if (impactVelocity > 0.1 && !crashSoundPlaying) {
-
-	//	Node* tempSoundNode = bodyA->GetNode()->CreateChild();
-	//	tempSoundNode->SetTemporary(true);
-
-	//	SoundSource3D* soundSource = tempSoundNode->CreateComponent<SoundSource3D>();
-	//	soundSource->SetTemporary(true);
-	//	soundSource->SetAutoRemoveMode(REMOVE_NODE);
-	//	soundSource->SetFarDistance(50);
-	//	soundSource->SetNearDistance(1);
-
-
-
-
-	//	int randSound = Random(1, 4);
-	//	Sound* impactSound;
-	//	//if(randSound == 0)
-	//	//	impactSound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/Metal Sounds/metal_sound_89.wav");
-	//	if (randSound == 1)
-	//		impactSound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/Metal Sounds/metal_sound_82.wav");
-	//	if (randSound == 2)
-	//		impactSound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/Metal Sounds/metal_sound_83.wav");
-	//	if (randSound == 3)
-	//		impactSound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/Metal Sounds/metal_sound_81.wav");
-	//	//if (randSound == 4)
-	//	//	impactSound = GetSubsystem<ResourceCache>()->GetResource<Sound>("Sounds/Metal Sounds/metal_sound_69.wav");
-
-
-	//	//soundSource->Play(impactSound, Random(44100 * 0.9f, 44100 * 1.1f), Clamp(impactVelocity, 0.0f, 0.25f));
-
-	//}
-}
-
-void TechGame::HandleNodeCollisionEnd(StringHash eventType, VariantMap& eventData)
-{
-
-}
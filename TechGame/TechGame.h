@@ -57,10 +57,6 @@ public:
 	/// Handle the post-render update event.
 	void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData);
 	
-	void HandleNodeCollisionStart(StringHash eventType, VariantMap& eventData);
-
-	void HandleNodeCollisionEnd(StringHash eventType, VariantMap& eventData);
-
 
 	void CreateCharacter();
 
@@ -79,7 +75,11 @@ protected:
 	/// Camera pitch angle.
 	float pitch_ = 0.0f;
 	
-	bool crashSoundPlaying = false;
+	/// Run the offline piece catalog build (-BuildPieceCatalog) instead of the game.
+	bool buildPieceCatalog_ = false;
+
+	/// Run a HeadlessSimulation benchmark (-Headless or the TechGameHeadless target) instead of the game.
+	bool headlessSimulation_ = false;
 	
 	/// Mouse mode option to use 
 	MouseMode useMouseMode_;